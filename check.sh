@@ -0,0 +1,285 @@
+#!/bin/bash
+# WSU-Crypt
+#
+# check.sh:
+#  round trip and equivalence tests for every mode, run by `make check`.
+#  works in a scratch directory and leaves the tree alone. the reference
+#  for each mode is a plain ECB run with the default settings
+
+
+W="$(cd "$(dirname "$0")" && pwd)/wsucrypt"
+T="$(mktemp -d)"
+trap 'rm -rf "$T"' EXIT
+cd "$T" || exit 1
+
+# no tuning profile, so every run uses the defaults plus its own options
+export WSUCRYPT_PROFILE="$T/no-profile"
+
+FAILED=0
+SECTION=0
+
+# report a section, ok only if nothing in it failed
+pass() {
+  if [ $SECTION -eq 0 ]; then
+    echo "ok:   $1"
+  fi
+  SECTION=0
+}
+
+fail() {
+  echo "FAIL: $1"
+  FAILED=1
+  SECTION=1
+}
+
+# run wsucrypt quietly, the debug builds print every block
+run() {
+  "$W" "$@" > /dev/null 2> err.txt
+}
+
+# N random blocks of upper case hex
+hexblocks() {
+  head -c $(($1 * 8)) /dev/urandom | od -An -v -tx1 | tr -d ' \n' | tr a-f A-F
+}
+
+# overwrite the character at offset $2 of file $1 with a different hex digit
+flip() {
+  local c
+  c="$(dd if="$1" bs=1 skip="$2" count=1 2> /dev/null)"
+  if [ "$c" = "A" ]; then c=B; else c=A; fi
+  printf '%s' "$c" | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# reference ECB encryption of $1 into $2
+ecbref() {
+  run -k key.txt -t "$1" -e && mv ciphertext.txt "$2"
+}
+
+
+printf 'ABCDEF0123456789' > key.txt
+printf '0123456789ABCDEF' > pt.txt
+hexblocks 1 > key2.txt
+hexblocks 20000 > a.txt
+hexblocks 20000 > b.txt
+
+
+## ECB: the known answer and a round trip
+
+run -k key.txt -t pt.txt -e
+[ "$(cat ciphertext.txt)" = "84F0ECE424282F79" ] || fail "ecb known answer"
+ecbref a.txt ecb_a.txt
+ecbref b.txt ecb_b.txt
+cp ecb_a.txt ciphertext.txt
+run -k key.txt -t dec.txt -d && cmp -s dec.txt a.txt || fail "ecb round trip"
+pass "ecb"
+
+
+## authenticated mode (CTR + PMAC): round trip, a bad tag or key is refused and leaves the old plaintext
+
+run -k key.txt -t a.txt -a -e -j 3 && run -k key.txt -t dec.txt -a -d -j 2 && cmp -s dec.txt a.txt || fail "auth round trip"
+cmp -s ciphertext.txt ecb_a.txt && fail "auth wrote ECB"
+cp a.txt dec.txt
+flip ciphertext.txt 4000
+run -k key.txt -t dec.txt -a -d && fail "auth accepted a tampered ciphertext"
+cmp -s dec.txt a.txt || fail "auth tampered ciphertext touched the output"
+run -k key.txt -t a.txt -a -e && run -k key2.txt -t dec.txt -a -d && fail "auth accepted the wrong key"
+pass "auth"
+
+
+## statistics: the report counts every block once, over all the threads
+
+run -k key.txt -t a.txt -e -j 4 -s json && cmp -s ciphertext.txt ecb_a.txt || fail "stats changed the output"
+grep -q '"blocks":20000,' err.txt || fail "stats block count"
+[ $(($(grep -o '"id":[0-9]*,"blocks":[0-9]*' err.txt | sed 's/.*://' | paste -sd+))) -eq 20000 ] || fail "stats per thread blocks"
+pass "stats"
+
+
+## kernels and tuning: every kernel and thread count gives the same blocks
+
+for k in ref sched table x4; do
+  for j in 1 4; do
+    run -k key.txt -t a.txt -e -K $k -j $j && cmp -s ciphertext.txt ecb_a.txt || fail "ecb -K $k -j $j"
+    run -k key.txt -t dec.txt -d -K $k -j $j && cmp -s dec.txt a.txt || fail "ecb -K $k -j $j decrypt"
+  done
+  run -k key.txt -t a.txt -a -e -K $k -j 3 && run -k key.txt -t dec.txt -a -d -K $k -j 2 && cmp -s dec.txt a.txt || fail "auth -K $k"
+done
+run tune -p profile.txt || fail "tune"
+grep -q '^kernel=' profile.txt || fail "tune wrote no kernel"
+run -k key.txt -t a.txt -e -p profile.txt && cmp -s ciphertext.txt ecb_a.txt || fail "ecb with the tuned profile"
+pass "kernels"
+
+
+## sector mode: threads agree, round trip, a range only touches its sectors
+
+head -c $((16 * 4096)) /dev/urandom > img.bin
+cp img.bin s1.bin
+cp img.bin s4.bin
+run -k key.txt -t s1.bin -e -S 4096 -j 1 && run -k key.txt -t s4.bin -e -S 4096 -j 4 && cmp -s s1.bin s4.bin || fail "sector threads"
+cmp -s s1.bin img.bin && fail "sector didnt change the image"
+run -k key.txt -t s1.bin -d -S 4096 && cmp -s s1.bin img.bin || fail "sector round trip"
+cp img.bin s1.bin
+run -k key.txt -t s1.bin -e -S 4096 -r 3:5
+cmp -s -n $((3 * 4096)) s1.bin img.bin || fail "sector range touched the sectors before it"
+cmp -s -i $((8 * 4096)) s1.bin img.bin || fail "sector range touched the sectors after it"
+run -k key.txt -t s1.bin -d -S 4096 -r 3:5 && cmp -s s1.bin img.bin || fail "sector range round trip"
+pass "sector"
+
+## multi-buffer CBC: round trip side by side, and the first block is E(P0 ^ IV)
+
+cp a.txt c1.txt
+cp b.txt c2.txt
+head -c 16000 a.txt > c3.txt
+run cbc -k key.txt -e c1.txt c2.txt c3.txt || fail "cbc encrypt"
+rm -f c1.txt c2.txt c3.txt
+run cbc -k key.txt -d c1.txt.cbc c2.txt.cbc c3.txt.cbc || fail "cbc decrypt"
+cmp -s c1.txt a.txt && cmp -s c2.txt b.txt && cmp -s c3.txt <(head -c 16000 a.txt) || fail "cbc round trip"
+iv="$(head -c 16 c1.txt.cbc)"
+p0="$(head -c 16 a.txt)"
+printf '%016X' $((0x$iv ^ 0x$p0)) > x0.txt
+run -k key.txt -t x0.txt -e
+[ "$(cat ciphertext.txt)" = "$(head -c 32 c1.txt.cbc | tail -c 16)" ] || fail "cbc first block"
+pass "cbc"
+
+## buffer pool: huge pages and small batches give the same blocks, and every buffer comes back
+
+for b in 1 64 100000; do
+  run -k key.txt -t a.txt -e -H -b $b -j 2 -s json && cmp -s ciphertext.txt ecb_a.txt || fail "pool -H -b $b"
+  grep -q '"in_use":0,' err.txt || fail "pool -b $b kept a buffer"
+done
+run -k key.txt -t dec.txt -d -H -b 64 && cmp -s dec.txt a.txt || fail "pool decrypt"
+cp img.bin s1.bin
+run -k key.txt -t s1.bin -e -S 512 -H && run -k key.txt -t s1.bin -d -S 512 -H && cmp -s s1.bin img.bin || fail "pool sector round trip"
+run -k key.txt -t a.txt -a -e -H -s json && grep -q '"in_use":0,' err.txt || fail "pool auth kept a buffer"
+run -k key.txt -t dec.txt -a -d -H && cmp -s dec.txt a.txt || fail "pool auth round trip"
+cp a.txt p1.txt
+head -c 16000 b.txt > p2.txt
+run cbc -k key.txt -e -H -s json p1.txt p2.txt && grep -q '"in_use":0,' err.txt || fail "pool cbc kept a buffer"
+rm -f p1.txt p2.txt
+run cbc -k key.txt -d -H p1.txt.cbc p2.txt.cbc && cmp -s p1.txt a.txt && cmp -s p2.txt <(head -c 16000 b.txt) || fail "pool cbc round trip"
+pass "pool"
+
+## NUMA placement: the topology reads, and placed workers give the same blocks
+
+run --topology && grep -q . err.txt && fail "topology complained"
+"$W" --topology | grep -q '^node 0:' || fail "topology found no node"
+run -k key.txt -t a.txt -e --numa -j 4 && cmp -s ciphertext.txt ecb_a.txt || fail "numa ecb"
+run -k key.txt -t a.txt -a -e --numa -j 4 && run -k key.txt -t dec.txt -a -d --numa -j 3 && cmp -s dec.txt a.txt || fail "numa auth"
+cp img.bin s2.bin
+cp img.bin s3.bin
+run -k key.txt -t s2.bin -e -S 512 -j 4 && run -k key.txt -t s3.bin -e -S 512 --numa -j 4 && cmp -s s2.bin s3.bin || fail "numa sector"
+rm -f ciphertext.txt ciphertext.txt.idx
+run -k key.txt -t a.txt -e -I -c 256 --numa -j 4 && cmp -s ciphertext.txt ecb_a.txt || fail "numa incremental"
+"$W" analyze diff 3 0000000000000000 0000000000000000 10000 -k key.txt --numa -j 4 | grep -q '"hits":10000,' || fail "numa analyze"
+pass "numa"
+
+## analysis: every DDT row adds up to 256, and the zero difference and mask always hold
+
+"$W" analyze sbox | grep -q '"bijective":true' || fail "analyze sbox"
+[ "$("$W" analyze ddt | awk '{ s = 0; for (i = 1; i <= NF; i++) s += $i; if (s != 256) bad++ } END { print NR, bad + 0 }')" = "256 0" ] || fail "analyze ddt rows"
+for kind in diff linear; do
+  "$W" analyze $kind 3 0000000000000000 0000000000000000 10000 -k key.txt -j 2 | grep -q '"samples":10000,"hits":10000,' || fail "analyze $kind zero"
+done
+pass "analyze"
+
+## avalanche and quality: a small run passes, and the report says so
+
+"$W" avalanche 4096 -j 2 > av.txt || fail "avalanche failed"
+grep -q '"pass":true' av.txt || fail "avalanche report"
+pass "avalanche"
+
+## incremental: only changed chunks are redone, and an index never outlives its output
+
+rm -f ciphertext.txt ciphertext.txt.idx
+run -k key.txt -t a.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a.txt || fail "incremental first run"
+cp a.txt a2.txt
+flip a2.txt 50000
+ecbref a2.txt ecb_a2.txt
+run -k key.txt -t a2.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a2.txt || fail "incremental one chunk changed"
+run -k key.txt -t a2.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a2.txt || fail "incremental nothing changed"
+# the stale index: a plain run writes b over the output, then a again
+run -k key.txt -t a.txt -e -I -c 256
+run -k key.txt -t b.txt -e && cmp -s ciphertext.txt ecb_b.txt || fail "incremental plain run in between"
+run -k key.txt -t a.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a.txt || fail "incremental stale index"
+# the same again with the output replaced behind the index's back
+run -k key.txt -t a.txt -e -I -c 256
+cp ecb_b.txt ciphertext.txt
+run -k key.txt -t a.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a.txt || fail "incremental replaced output"
+# a patch cut short: the output changed under an index marked invalid
+run -k key.txt -t a.txt -e -I -c 256
+m="$(stat -c %y ciphertext.txt)"
+flip ciphertext.txt 100
+touch -d "$m" ciphertext.txt
+dd if=/dev/zero of=ciphertext.txt.idx bs=1 seek=72 count=8 conv=notrunc 2> /dev/null
+run -k key.txt -t a.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a.txt || fail "incremental invalid index"
+# a different key
+run -k key2.txt -t a.txt -e -I -c 256
+run -k key.txt -t a.txt -e -I -c 256 && cmp -s ciphertext.txt ecb_a.txt || fail "incremental other key"
+pass "incremental"
+
+## sharding: plan, work and merge give a container that decrypts like any other; a changed input is refused
+
+run shard plan 3 -k key.txt -t a.txt || fail "shard plan"
+for i in 0 1 2; do
+  run shard work ciphertext.txt.manifest $i -k key.txt || fail "shard work $i"
+done
+run merge ciphertext.txt.manifest -k key.txt || fail "shard merge"
+run -k key.txt -t dec.txt -a -d && cmp -s dec.txt a.txt || fail "shard round trip"
+run shard plan 2 -k key.txt -t b.txt
+run shard work ciphertext.txt.manifest 0 -k key.txt
+run merge ciphertext.txt.manifest -k key.txt && fail "shard merged with a shard missing"
+run shard work ciphertext.txt.manifest 1 -k key2.txt && fail "shard worked under the wrong key"
+cp b.txt b2.txt
+run shard plan 2 -k key.txt -t b2.txt
+flip b2.txt 100
+rm -f ciphertext.txt.shard0
+run shard work ciphertext.txt.manifest 0 -k key.txt && fail "shard worked on a changed input"
+[ -e ciphertext.txt.shard0 ] && fail "shard wrote output for a changed input"
+pass "shard"
+
+## key store: keys from the store give the same blocks as the key files, damage is caught
+
+run keystore build keys.bin main=key.txt other=key2.txt -K table || fail "keystore build"
+run keystore list keys.bin || fail "keystore list"
+for k in sched table; do
+  run -x keys.bin -k main -t a.txt -e -K $k && cmp -s ciphertext.txt ecb_a.txt || fail "keystore -K $k"
+done
+run -x keys.bin -k other -t a.txt -e && cmp -s ciphertext.txt ecb_a.txt && fail "keystore gave the wrong key"
+run -x keys.bin -k none -t a.txt -e && fail "keystore found a missing key"
+run keystore verify keys.bin || fail "keystore verify"
+cp keys.bin bad.bin
+printf 'X' | dd of=bad.bin bs=1 seek=$(($(stat -c %s bad.bin) - 100)) conv=notrunc 2> /dev/null
+run keystore verify bad.bin && fail "keystore verify missed damaged tables"
+pass "keystore"
+
+## pipeline: every depth gives the plain output, and every stage is reported
+
+for d in 1 2 3 4 8 64; do
+  run -k key.txt -t a.txt -e -P $d -b 64 -j 2 && cmp -s ciphertext.txt ecb_a.txt || fail "pipeline -P $d"
+done
+run -k key.txt -t dec.txt -d -P 4 -b 64 -s json && cmp -s dec.txt a.txt || fail "pipeline decrypt"
+[ "$(grep -o '"stage":' err.txt | wc -l)" -eq 5 ] || fail "pipeline report"
+pass "pipeline"
+
+## memo: repeats and zero runs give the plain output, and the hits are counted
+
+{
+  for i in $(seq 200); do
+    head -c 1600 a.txt
+    printf '0000000000000000%.0s' $(seq 50)
+    head -c 800 b.txt
+  done
+  cat b.txt
+} > m.txt
+ecbref m.txt ecb_m.txt
+for j in 1 4; do
+  run -k key.txt -t m.txt -e -M 4096 -j $j -s json && cmp -s ciphertext.txt ecb_m.txt || fail "memo -j $j"
+  grep -q '"memo":{"lookups":[0-9]*,"hits":[1-9][0-9]*,"zero_blocks":[1-9]' err.txt || fail "memo -j $j counted no hits"
+done
+run -k key.txt -t dec.txt -d -M 4096 && cmp -s dec.txt m.txt || fail "memo decrypt"
+pass "memo"
+
+if [ $FAILED -ne 0 ]; then
+  echo "some checks failed"
+  exit 1
+fi
+echo "all checks passed"
@@ -18,14 +18,34 @@
 //  depending on the mode passed from the command line
 
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "util.h"
 #include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_auth.h"
+#include "wsu_stats.h"
+#include "wsu_tune.h"
+#include "wsu_sector.h"
+#include "wsu_mbuf.h"
+#include "wsu_pool.h"
+#include "wsu_numa.h"
+#include "wsu_analyze.h"
+#include "wsu_quality.h"
+#include "wsu_incr.h"
+#include "wsu_shard.h"
+#include "wsu_keystore.h"
+#include "wsu_pipe.h"
+#include "wsu_memo.h"
 
 
 // help text
@@ -38,21 +58,86 @@ CS427, Spring 2019, Project 1\n\
 WSU Vancouver\n\n\
 Block cipher based on AES candidate \'Twofish\' and the NSA\'s \'SKIPJACK\'\n\n\n\
 Usage:\n\
-  ./wsucrypt [OPTIONS]\n\n\
+  ./wsucrypt [OPTIONS]\n\
+  ./wsucrypt tune [-p FNAME]  Benchmark this host and save the fastest settings\n\
+  ./wsucrypt cbc [OPTIONS] FILE...\n\
+                              CBC encrypt (FILE.cbc) or decrypt many files side by side\n\
+  ./wsucrypt analyze (sbox|ddt|lat)\n\
+                              F-Table difference and linear approximation tables\n\
+  ./wsucrypt analyze (diff|linear) ROUNDS IN OUT [SAMPLES]\n\
+                              Sample a differential or linear approximation over ROUNDS rounds\n\
+  ./wsucrypt shard plan N     Split an authenticated encryption of the text file into N shards\n\
+  ./wsucrypt shard work MANIFEST I\n\
+                              Encrypt shard I of a manifest into its shard file\n\
+  ./wsucrypt merge MANIFEST   Check every shard and write the final container\n\
+  ./wsucrypt avalanche [SAMPLES]\n\
+                              Avalanche, bit independence and balance tests (exit 1 on failure)\n\
+  ./wsucrypt keystore build STORE ID=KEYFILE...\n\
+                              Expand keys and their G tables once into a key store\n\
+  ./wsucrypt keystore list STORE\n\
+                              List the keys in a key store\n\
+  ./wsucrypt keystore verify STORE\n\
+                              Check every key and table in a key store\n\n\
 Options:\n\
-  -k <FNAME>     --key <FNAME>     Use given key file\n\
+  -k <FNAME>     --key <FNAME>     Use given key file (a key ID with -x)\n\
+  -x <FNAME>     --keystore <FNAME>\n\
+                                   Take the expanded key from a key store\n\
   -t <FNAME>     --text <FNAME>    Use given text file\n\
   -e [FNAME]     --encrypt [FNAME] Perform an encryption on the text file (optional output name)\n\
   -d [FNAME]     --decrypt [FNAME] Perform a decryption on the text file (optional output name)\n\
+  -a             --auth            Authenticated mode (CTR encryption with a PMAC tag)\n\
+  -j <N>         --threads <N>     Number of worker threads for the block engine\n\
+  -s <FMT>       --stats <FMT>     Print throughput statistics at exit (FMT: json)\n\
+  -i <SEC>       --interval <SEC>  Also print statistics every SEC seconds\n\
+  -K <NAME>      --kernel <NAME>   Block kernel (ref, sched, table, x4)\n\
+  -c <N>         --chunk <N>       Blocks per engine chunk\n\
+  -b <N>         --batch <N>       Blocks read from disk at a time\n\
+  -p <FNAME>     --profile <FNAME> Tuning profile (default $WSUCRYPT_PROFILE or ~/.wsucrypt-<host>)\n\
+  -H             --hugepages       Back the buffer pool with huge pages\n\
+  -M <N>         --memo <N>        Remember up to N blocks per worker and skip repeats and zero runs (ECB)\n\
+  -P <N>         --pipeline <N>    Run read, decode, cipher, encode and write as a pipeline, N batches deep (ECB)\n\
+  -n             --numa            Pin workers per NUMA node and keep their keys and buffers local\n\
+  -T             --topology        Print the NUMA topology and exit\n\
+  -I             --incremental     Only redo chunks whose input changed since the last run (ECB)\n\
+  -S <SIZE>      --sector <SIZE>   Sector mode: encrypt the text file as a raw disk image in place\n\
+  -r <F:N>       --range <F:N>     Only touch N sectors starting at sector F (sector mode)\n\
   -h             --help            Show this help text\n");
   
 }
 
+// settings passed from command line
+typedef struct WC_OPTS {
+  char mode;                  // 0 for encrypt, nonzero for decrypt, -1 used for parsing init check
+  char auth;                  // nonzero for authenticated mode
+  char stats;                 // nonzero to print JSON statistics
+  char hugepages;             // nonzero to back the buffer pool with huge pages
+  char numa;                  // nonzero to place workers and memory per NUMA node
+  char topology;              // nonzero to just print the topology
+  char incremental;           // nonzero to only redo changed chunks
+  unsigned int interval;      // seconds between periodic statistics, 0 for only at exit
+  unsigned int pipeline;      // batches in flight through the staged ECB driver, 0 for the plain loop
+  uint64_t memo;              // blocks each ECB worker remembers, 0 for no memo
+  unsigned int sectorsize;    // nonzero for sector mode
+  uint64_t sectorfirst;       // first sector to touch
+  uint64_t sectorcount;       // sectors to touch, 0 for through the end of the image
+  WC_PROFILE prof;            // engine settings, zero (or WC_NUM_KERNELS) if not given
+  char profilepath[MAX_BUFF];
+  char keypath[MAX_BUFF];      // key file, or key ID when theres a key store
+  char keystorepath[MAX_BUFF];
+  char textpath[MAX_BUFF];
+  char cipherpath[MAX_BUFF];
+  char** files;               // arguments that arent options, in order
+  int nfiles;
+} WC_OPTS;
+
 // parse arguments from cli
-void parseArgs(int argc, char** argv, char* keypath, char* textpath, char* mode) {
+void parseArgs(int argc, char** argv, WC_OPTS* opts) {
   for (int i = 0; i < argc; i++) {
-    // skip improperly formatted args
+    // keep anything that isnt an option (subcommands and their files)
     if (argv[i][0] != '-') {
+      if (i > 0) {
+        opts->files[opts->nfiles++] = argv[i];
+      }
       continue;
     }
     
@@ -64,7 +149,7 @@ void parseArgs(int argc, char** argv, char* keypath, char* textpath, char* mode)
     
     // key file
     else if ((strcmp("-k", argv[i]) == 0) || (strcmp("--key", argv[i]) == 0)) {
-    
+      
       // cap filename length to avoid overflow
       int maxcpy = strlen(argv[i+1])+1;
       if (maxcpy > MAX_BUFF) {
@@ -75,12 +160,20 @@ void parseArgs(int argc, char** argv, char* keypath, char* textpath, char* mode)
       }
       
       // copy new filename
-      strncpy(keypath, argv[i+1], maxcpy);
+      snprintf(opts->keypath, maxcpy, "%s", argv[i+1]);
       
       // bump i past the filename
       i++;
     }
     
+    // key store
+    else if ((strcmp("-x", argv[i]) == 0) || (strcmp("--keystore", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        snprintf(opts->keystorepath, MAX_BUFF, "%s", argv[i+1]);
+        i++;
+      }
+    }
+    
     // plaintext file
     else if ((strcmp("-t", argv[i]) == 0) || (strcmp("--text", argv[i]) == 0)) {
       
@@ -94,7 +187,7 @@ void parseArgs(int argc, char** argv, char* keypath, char* textpath, char* mode)
       }
       
       // copy new filename
-      strncpy(textpath, argv[i+1], maxcpy);
+      snprintf(opts->textpath, maxcpy, "%s", argv[i+1]);
       
       // bump i past the filename
       i++;
@@ -102,199 +195,1737 @@ void parseArgs(int argc, char** argv, char* keypath, char* textpath, char* mode)
     
     // encryption
     else if ((strcmp("-e", argv[i]) == 0) || (strcmp("--encrypt", argv[i]) == 0)) {
-      *mode = 0;
+      opts->mode = 0;
     }
     
     // decryption
     else if ((strcmp("-d", argv[i]) == 0) || (strcmp("--decrypt", argv[i]) == 0)) {
-      *mode = 1;
+      opts->mode = 1;
+    }
+    
+    // authenticated mode
+    else if ((strcmp("-a", argv[i]) == 0) || (strcmp("--auth", argv[i]) == 0)) {
+      opts->auth = 1;
+    }
+    
+    // worker threads
+    else if ((strcmp("-j", argv[i]) == 0) || (strcmp("--threads", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->prof.threads = atoi(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // statistics format
+    else if ((strcmp("-s", argv[i]) == 0) || (strcmp("--stats", argv[i]) == 0)) {
+      if (i+1 >= argc || strcmp("json", argv[i+1]) != 0) {
+        fprintf(stderr, "[ERR!]: unknown stats format. only json is supported.\n");
+        exit(EXIT_FAILURE);
+      }
+      opts->stats = 1;
+      i++;
+    }
+    
+    // periodic statistics
+    else if ((strcmp("-i", argv[i]) == 0) || (strcmp("--interval", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->interval = atoi(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // block kernel
+    else if ((strcmp("-K", argv[i]) == 0) || (strcmp("--kernel", argv[i]) == 0)) {
+      if (i+1 >= argc || (opts->prof.kernel = wcKernelParse(argv[i+1])) == WC_NUM_KERNELS) {
+        fprintf(stderr, "[ERR!]: unknown kernel. use ref, sched, table or x4.\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    
+    // engine chunk size
+    else if ((strcmp("-c", argv[i]) == 0) || (strcmp("--chunk", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->prof.chunk = atoll(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // read batch size
+    else if ((strcmp("-b", argv[i]) == 0) || (strcmp("--batch", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->prof.batch = atoll(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // ECB memo
+    else if ((strcmp("-M", argv[i]) == 0) || (strcmp("--memo", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->memo = atoll(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // staged pipeline
+    else if ((strcmp("-P", argv[i]) == 0) || (strcmp("--pipeline", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->pipeline = atoi(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // huge pages
+    else if ((strcmp("-H", argv[i]) == 0) || (strcmp("--hugepages", argv[i]) == 0)) {
+      opts->hugepages = 1;
+    }
+    
+    // NUMA placement
+    else if ((strcmp("-n", argv[i]) == 0) || (strcmp("--numa", argv[i]) == 0)) {
+      opts->numa = 1;
+    }
+    
+    // topology report
+    else if ((strcmp("-T", argv[i]) == 0) || (strcmp("--topology", argv[i]) == 0)) {
+      opts->topology = 1;
+    }
+    
+    // incremental
+    else if ((strcmp("-I", argv[i]) == 0) || (strcmp("--incremental", argv[i]) == 0)) {
+      opts->incremental = 1;
+    }
+    
+    // sector mode
+    else if ((strcmp("-S", argv[i]) == 0) || (strcmp("--sector", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        opts->sectorsize = atoi(argv[i+1]);
+        i++;
+      }
+    }
+    
+    // sector range
+    else if ((strcmp("-r", argv[i]) == 0) || (strcmp("--range", argv[i]) == 0)) {
+      unsigned long long f;
+      unsigned long long n;
+      if (i+1 >= argc || sscanf(argv[i+1], "%llu:%llu", &f, &n) != 2) {
+        fprintf(stderr, "[ERR!]: bad sector range. use FIRST:COUNT.\n");
+        exit(EXIT_FAILURE);
+      }
+      opts->sectorfirst = f;
+      opts->sectorcount = n;
+      i++;
+    }
+    
+    // profile file
+    else if ((strcmp("-p", argv[i]) == 0) || (strcmp("--profile", argv[i]) == 0)) {
+      if (i+1 < argc) {
+        snprintf(opts->profilepath, MAX_BUFF, "%s", argv[i+1]);
+        i++;
+      }
     }
   }
   
   return;
 }
 
-// entry point
-int main(int argc, char** argv) {
-  // too few args
-  if (argc < 2) {
-  
-#ifdef DEBUG
-  printf("[DBUG]: no args\n");
-#endif //DEBUG
+// add the time since *start to a driver stage and restart the clock
+void stageDone(WC_STAGE stage, uint64_t* start) {
+  uint64_t now = wcNow();
+  WC_STAT_ADD_SHARED(0, stagens[stage], now - *start);
+  *start = now;
+  return;
+}
 
-    printHelp();
+// hex blocks in a whole file, any trailing partial block is dropped
+// same as the block by block loop
+uint64_t hexFileBlocks(FILE* f) {
+  fseek(f, 0, SEEK_END);
+  long textlen = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  return (textlen/2)/BLOCK_SIZE;
+}
+
+// set up pool with count buffers of nblocks hex blocks each, for the modes
+// that hold a whole file at once
+void hexPoolInit(WC_OPTS* opts, WC_POOL* pool, uint64_t nblocks, unsigned int count) {
+  WC_ERR e;
+  // an empty file still gets a buffer, the pool doesnt make empty ones
+  if ((e = wcPoolInit(pool, (nblocks ? nblocks : 1) * 2*BLOCK_SIZE, count, opts->hugepages ? WC_POOL_HUGE : 0)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcPoolInit returned error code: %d, %s\n", e, wcerr(e));
     exit(EXIT_FAILURE);
   }
+  wcStatsWatchPool(pool);
+  return;
+}
+
+// read up to nblocks hex blocks from the start of f into buff and convert
+// them to bytes in place. buff needs room for the hex, returns the blocks read
+uint64_t readHexBlocks(FILE* f, unsigned char* buff, uint64_t nblocks) {
   
-  // settings passed from command line
-  // flags
-  char mode = -1;    // 0 for encrypt, nonzero for decrypt, -1 used for parsing init check
+  uint64_t start = wcNow();
   
-  // cap the buffer size
-  char keypath[MAX_BUFF];
-  char textpath[MAX_BUFF];
-  char cipherpath[MAX_BUFF];
+  fseek(f, 0, SEEK_SET);
+  nblocks = fread(buff, 1, nblocks * 2*BLOCK_SIZE, f) / (2*BLOCK_SIZE);
+  stageDone(WC_STAGE_READ, &start);
   
-  // default filenames for assignment
-  strcpy(keypath, "key.txt");
-  strcpy(textpath, "plaintext.txt");
-  strcpy(cipherpath, "ciphertext.txt");
+  int e;
+  if ((e = hexblocks_decode(buff, nblocks)) != U_OK) {
+    fprintf(stderr, "[ERR!]: hexblocks_decode returned error code: %d, %s\n", e, utilerr(e));
+    exit(EXIT_FAILURE);
+  }
+  stageDone(WC_STAGE_DECODE, &start);
   
-  // parse arguments into locals
-  parseArgs(argc, argv, keypath, textpath, &mode);
+  return nblocks;
+}
+
+// blocks writeHexBlocks() converts at a time
+#define HEX_PIECE 4096
+
+// write nblocks blocks out as hex strings
+// goes a piece at a time through the stack so nothing the size of the
+// output gets allocated
+void writeHexBlocks(FILE* f, unsigned char* bytes, uint64_t nblocks) {
   
-  // if we didnt get a mode, error out
-  if (mode == -1) {
-    fprintf(stderr, "[ERR!]: failed to supply mode. use -e (--encrypt) or -d (--decrypt).\n");
-    exit(EXIT_FAILURE);
+  uint64_t start = wcNow();
+  unsigned char hex[HEX_PIECE * 2*BLOCK_SIZE];
+  
+  while (nblocks > 0) {
+    uint64_t n = (nblocks < HEX_PIECE) ? nblocks : HEX_PIECE;
+    
+    // the hex takes up the whole piece, so the bytes go in first and are
+    // expanded in place
+    memcpy(hex, bytes, n * BLOCK_SIZE);
+    hexblocks_encode(hex, n);
+    stageDone(WC_STAGE_ENCODE, &start);
+    
+    fwrite(hex, 1, n * 2*BLOCK_SIZE, f);
+    stageDone(WC_STAGE_WRITE, &start);
+    
+    bytes += n * BLOCK_SIZE;
+    nblocks -= n;
   }
   
-#ifdef DEBUG
-  printf("[DBUG]: parsed args:\n key = %s\n text = %s\n mode = %s\n", keypath, textpath, mode?"decrypt":"encrypt");
-#endif //DEBUG
+  return;
+}
+
+// read the key's hex string and convert it to bytes
+void readKey(FILE* keyfile, unsigned char* key) {
+  unsigned char kstr[2*KEY_SIZE+1];
+  int e;
   
-  // open the files from disk
-  FILE* keyfile = fopen(keypath, "r");
-  FILE* plainfile;
-  FILE* cipherfile;
+  if (fread(kstr, 1, 2*KEY_SIZE, keyfile) != 2*KEY_SIZE) {
+    fprintf(stderr, "[ERR!]: key file too short, need %d hex characters\n", 2*KEY_SIZE);
+    exit(EXIT_FAILURE);
+  }
+  if ((e = hexstr_bytes(kstr, key, KEY_SIZE)) != U_OK) {
+    fprintf(stderr, "[ERR!]: hexstr_bytes returned error code: %d, %s\n", e, utilerr(e));
+    exit(EXIT_FAILURE);
+  }
   
-  // information derived from the file
-  unsigned int textlen;
-  unsigned int blockcount;
+  return;
+}
+
+// raw key and schedule for the run, with the keyed tables if kernel uses them
+// with a key store (-x) the schedule comes out of the mapping already
+// expanded and -k names the key, otherwise -k is the key file. the store
+// stays mapped until exit since the schedule's tables live in it
+// sched can be NULL when only the raw key is wanted
+void loadKey(WC_OPTS* opts, WC_KERNEL kernel, unsigned char* key, WC_SCHED* sched) {
   
-  // holds error codes
+  static WC_KEYSTORE store;
   int e;
+  WC_SCHED tmp;
+  int built = 0;
   
-  // TODO (Dragon): could save memory and just use the big buffers for str and bytes
-  //       bytes in first half of buffer after conversion
-  //       just replace character pairs with 0 and "append" the byte to first half till you hit the end
-  //
-  //       not really necessary at all here but just a thought
+  if (sched == NULL) {
+    sched = &tmp;
+  }
   
-  // buffers for the block and key
-  unsigned char bstr[2*BLOCK_SIZE+1];   // holds the block's hex string chars before/after conversion to/from bytes
-  unsigned char kstr[2*KEY_SIZE+1];     // holds the key's hex string chars before conversion to bytes
-  unsigned char pblock[BLOCK_SIZE];     // holds the bytes for the plaintext block
-  unsigned char cblock[BLOCK_SIZE];     // holds the bytes for the ciphertext block
-  unsigned char key[KEY_SIZE];          // holds the bytes for the key
+  if (opts->keystorepath[0]) {
+    if (store.base == NULL && (e = wcKeyStoreOpen(opts->keystorepath, &store)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: couldnt open key store %s, or it was written by a different build\n", opts->keystorepath);
+      exit(EXIT_FAILURE);
+    }
+    if ((e = wcKeyStoreGet(&store, opts->keypath, sched)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: key %s: wcKeyStoreGet returned error code: %d, %s\n", opts->keypath, e, wcerr(e));
+      exit(EXIT_FAILURE);
+    }
+    memcpy(key, sched->key, KEY_SIZE);
+  }
+  else {
+    FILE* keyfile = fopen(opts->keypath, "r");
+    if (keyfile == NULL) {
+      fprintf(stderr, "[ERR!]: couldnt open key file %s\n", opts->keypath);
+      exit(EXIT_FAILURE);
+    }
+    readKey(keyfile, key);
+    fclose(keyfile);
+    if ((e = wcSchedule(key, sched)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcSchedule returned error code: %d, %s\n", e, wcerr(e));
+      exit(EXIT_FAILURE);
+    }
+    built = 1;
+  }
   
+  if (sched == &tmp) {
+    return;
+  }
+  if (kernel == WC_KERN_TABLE && sched->tables == NULL) {
+    if ((e = wcScheduleTables(sched)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcScheduleTables returned error code: %d, %s\n", e, wcerr(e));
+      exit(EXIT_FAILURE);
+    }
+    built = 1;
+  }
+  if (built) {
+    WC_STAT_ADD(0, keysetups, 1);
+  }
   
-  // do the operation
-  if (!mode) {  // ENCRYPTION
-    plainfile = fopen(textpath, "r");
-    cipherfile = fopen(cipherpath, "w");
-    
-    // get the size of the input file
-    fseek(plainfile, 0, SEEK_END);
-    textlen = ftell(plainfile);
-    fseek(plainfile, 0, SEEK_SET);
-    
-    // find out how many blocks to encrypt (round up)
-    blockcount = ceil((textlen/2)/BLOCK_SIZE);
-    
-    // process every block and write it to the ciphertext file
-    for (int i = 0; i < blockcount; i++) {
-      
-      // read the hex strings from given files
-      fread(bstr, 1, 2*BLOCK_SIZE, plainfile);
-      fread(kstr, 1, 2*KEY_SIZE, keyfile);
-      
-      // convert input (plaintext) hex string to byte array
-      if ((e = hexstr_bytes(bstr, pblock, BLOCK_SIZE)) != U_OK) {
-        fprintf(stderr, "[ERR!]: hexstr_bytes returned error code: %d, %s\n", e, utilerr(e));
-        exit(EXIT_FAILURE);
-      }
-      
-      // clear out the string for temp storage
-      memset(bstr, 0, 2*BLOCK_SIZE+1);
-      
-      // convert key hex string to byte array
-      if ((e = hexstr_bytes(kstr, key, KEY_SIZE)) != U_OK) {
-        fprintf(stderr, "[ERR!]: hexstr_bytes returned error code: %d, %s\n", e, utilerr(e));
-        exit(EXIT_FAILURE);
+  return;
+}
+
+// swap the keyed tables of sched for a copy on node
+// the schedule itself is small enough to copy along with whatever holds it
+void replicateTables(WC_TOPO* topo, WC_SCHED* sched, int node) {
+  if (sched->tables != NULL) {
+    WC_TABLES* t = wcNumaCopy(topo, sched->tables, sizeof(WC_TABLES), node);
+    if (t == NULL) {
+      fprintf(stderr, "[ERR!]: couldnt replicate key tables on node %d\n", node);
+      exit(EXIT_FAILURE);
+    }
+    sched->tables = t;
+  }
+  return;
+}
+
+// node local copy of something holding a schedule, for every node the engine uses
+// copies[0..] all point at src when theres no topology. schedOf(p, i) gives
+// the i'th schedule p holds, NULL past the last one
+void replicateKeys(WC_TOPO* topo, void* src, size_t len, WC_SCHED* (*schedOf)(void*, int), void** copies) {
+  for (int n = 0; n < WC_MAX_NODES; n++) {
+    copies[n] = src;
+  }
+  if (topo == NULL) {
+    return;
+  }
+  for (int n = 0; n < topo->nnodes; n++) {
+    if ((copies[n] = wcNumaCopy(topo, src, len, n)) == NULL) {
+      fprintf(stderr, "[ERR!]: couldnt replicate keys on node %d\n", n);
+      exit(EXIT_FAILURE);
+    }
+    WC_SCHED* sched;
+    for (int i = 0; (sched = schedOf(copies[n], i)) != NULL; i++) {
+      replicateTables(topo, sched, n);
+    }
+  }
+  return;
+}
+
+// undo replicateKeys()
+void releaseKeys(WC_TOPO* topo, size_t len, WC_SCHED* (*schedOf)(void*, int), void** copies) {
+  if (topo == NULL) {
+    return;
+  }
+  for (int n = 0; n < topo->nnodes; n++) {
+    WC_SCHED* sched;
+    for (int i = 0; (sched = schedOf(copies[n], i)) != NULL; i++) {
+      if (sched->tables != NULL) {
+        wcNumaRelease(sched->tables, sizeof(WC_TABLES));
       }
-      
-      // pass the cblock as an arg to do a clean copy inside WSU-Crypt
-      // wcEncrypt returns error codes, check for errors here
-      if ((e = wcCipher(pblock, cblock, key, 'e')) != WC_OK) {
-        fprintf(stderr, "[ERR!]: wcEncrypt returned error code: %d, %s\n", e, wcerr(e));
-        exit(EXIT_FAILURE);
+    }
+    wcNumaRelease(copies[n], len);
+  }
+  return;
+}
+
+// put the part of buff each node's workers will cipher on that node
+// stride is the bytes per block in buff
+void bindRegions(WC_TOPO* topo, WC_PROFILE* prof, uint64_t nblocks, unsigned char* buff, size_t stride) {
+  if (topo == NULL) {
+    return;
+  }
+  for (int n = 0; n < topo->nnodes; n++) {
+    uint64_t first;
+    uint64_t count;
+    wcEngineRegion(prof->threads, prof->chunk, nblocks, n, &first, &count);
+    if (count) {
+      wcNumaBind(topo, buff + first*stride, count*stride, n);
+    }
+  }
+  return;
+}
+
+// arguments for ecbChunk(), shared by every engine worker
+typedef struct WC_ECB_JOB {
+  WC_KERNEL kernel;
+  WC_SCHED* scheds[WC_MAX_NODES];   // one copy of the key per node
+  unsigned char* buff;    // blocks are ciphered in place
+  char mode;
+  uint64_t memoentries;             // blocks each worker remembers, 0 for no memo
+  WC_MEMO* memos[WC_MAX_THREADS];   // each worker's memo, made on its first chunk
+} WC_ECB_JOB;
+
+// engine work function for plain block by block mode
+WC_ERR ecbChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_ECB_JOB* job = arg;
+  unsigned char* blocks = job->buff + first*BLOCK_SIZE;
+  WC_SCHED* sched = job->scheds[wcEngineNode(thread)];
+  
+  if (job->memoentries) {
+    // made by the worker itself so the table lands on its node, and kept
+    // for every batch after this one since worker numbers dont change
+    WC_MEMO* memo = job->memos[thread];
+    if (memo == NULL) {
+      WC_ERR e;
+      if ((memo = malloc(sizeof(WC_MEMO))) == NULL) {
+        return WC_BAD_ALLOC;
       }
-      
-      // convert output (ciphertext) byte array to hex string
-      if ((e = bytes_hexstr(cblock, bstr, BLOCK_SIZE)) != U_OK) {
-        fprintf(stderr, "[ERR!]: bytes_hexstr returned error code: %d, %s\n", e, utilerr(e));
-        exit(EXIT_FAILURE);
+      if ((e = wcMemoInit(memo, job->memoentries, thread)) != WC_OK) {
+        free(memo);
+        return e;
       }
-      
-      // write the new ciphertext block to the generated ciphertext file
-      fwrite(bstr, 1, 2*BLOCK_SIZE, cipherfile);
+      job->memos[thread] = memo;
+    }
+    return wcMemoBlocks(memo, job->kernel, sched, blocks, count, job->mode);
+  }
+  
+  return wcCipherBlocks(job->kernel, sched, blocks, blocks, count, job->mode);
+}
+
+// free the memos ecbChunk() made
+void releaseMemos(WC_ECB_JOB* job) {
+  for (int i = 0; i < WC_MAX_THREADS; i++) {
+    if (job->memos[i] != NULL) {
+      wcMemoFree(job->memos[i]);
+      free(job->memos[i]);
+      job->memos[i] = NULL;
+    }
+  }
+  return;
+}
+
+// replicateKeys() accessors
+WC_SCHED* schedOfSched(void* p, int i) {
+  return (i == 0) ? p : NULL;
+}
+WC_SCHED* schedOfAuth(void* p, int i) {
+  WC_AUTH* ctx = p;
+  return (i == 0) ? &ctx->sched : (i == 1) ? &ctx->macsched : NULL;
+}
+WC_SCHED* schedOfSector(void* p, int i) {
+  WC_SECTOR* ctx = p;
+  return (i == 0) ? &ctx->data : (i == 1) ? &ctx->tweak : NULL;
+}
+
+// arguments for the pipelined ECB stages
+typedef struct WC_ECB_STAGES {
+  FILE* infile;
+  FILE* outfile;
+  uint64_t batch;
+  WC_PROFILE* prof;
+  WC_ECB_JOB* job;
+} WC_ECB_STAGES;
+
+// pipeline stages for ECB, the same steps as the loop in doECB()
+// any trailing partial block is dropped
+WC_ERR readStage(void* arg, WC_PIPE_ITEM* item) {
+  WC_ECB_STAGES* st = arg;
+  item->nblocks = fread(item->buff, 1, st->batch * 2*BLOCK_SIZE, st->infile) / (2*BLOCK_SIZE);
+  return WC_OK;
+}
+
+WC_ERR decodeStage(void* arg, WC_PIPE_ITEM* item) {
+  return (hexblocks_decode(item->buff, item->nblocks) == U_OK) ? WC_OK : WC_BAD_SRC_BLOCK;
+}
+
+// only this stage's thread touches the job, and the engine workers it
+// starts are the stage's own set of threads
+WC_ERR cipherStage(void* arg, WC_PIPE_ITEM* item) {
+  WC_ECB_STAGES* st = arg;
+  st->job->buff = item->buff;
+  return wcEngineRun(st->prof->threads, st->prof->chunk, item->nblocks, ecbChunk, st->job);
+}
+
+WC_ERR encodeStage(void* arg, WC_PIPE_ITEM* item) {
+  hexblocks_encode(item->buff, item->nblocks);
+  return WC_OK;
+}
+
+WC_ERR writeStage(void* arg, WC_PIPE_ITEM* item) {
+  WC_ECB_STAGES* st = arg;
+  if (fwrite(item->buff, 1, item->nblocks * 2*BLOCK_SIZE, st->outfile) != item->nblocks * 2*BLOCK_SIZE) {
+    return WC_BAD_FILE;
+  }
 #ifdef DEBUG
-      printf("[DBUG]: wrote %s\n", bstr);
+  printf("[DBUG]: wrote %llu blocks\n", (unsigned long long)item->nblocks);
 #endif //DEBUG
+  return WC_OK;
+}
+
+// plain block by block encryption/decryption
+// streams the file through in batches so every stage gets timed once per
+// batch instead of once per 8 byte block. pool is set up here and left for
+// the caller to free once its been reported on. topo is NULL unless the
+// workers are being placed per node
+void doECB(WC_OPTS* opts, FILE* infile, FILE* outfile, char mode, WC_PROFILE* prof, WC_POOL* pool, int poolflags, WC_TOPO* topo) {
+  
+  int e;
+  unsigned char key[KEY_SIZE];
+  WC_SCHED sched;
+  
+  // the key only needs expanding once for the whole file
+  loadKey(opts, prof->kernel, key, &sched);
+  
+  uint64_t batch = prof->batch;
+  unsigned int depth = opts->pipeline ? opts->pipeline : 1;
+  if (depth > WC_PIPE_MAX_DEPTH) {
+    depth = WC_PIPE_MAX_DEPTH;
+  }
+  
+  // hex text for the batch, converted to bytes in place in its first half
+  // one buffer for every batch in flight
+  if ((e = wcPoolInit(pool, batch * 2*BLOCK_SIZE, depth, poolflags)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcPoolInit returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  wcStatsWatchPool(pool);
+  
+  WC_ECB_JOB job;
+  memset(&job, 0, sizeof(job));
+  job.kernel = prof->kernel;
+  replicateKeys(topo, &sched, sizeof(sched), schedOfSched, (void**)job.scheds);
+  job.mode = mode;
+  job.memoentries = opts->memo;
+  
+  if (opts->pipeline) {
+    // static so the final statistics report can still see its counters
+    static WC_PIPE pipe;
+    WC_ECB_STAGES stages = {infile, outfile, batch, prof, &job};
+    
+    if ((e = wcPipeInit(&pipe, pool, depth)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcPipeInit returned error code: %d, %s\n", e, wcerr(e));
+      exit(EXIT_FAILURE);
     }
+    for (unsigned int i = 0; i < depth; i++) {
+      bindRegions(topo, prof, batch, pipe.items[i].buff, BLOCK_SIZE);
+    }
+    // a stage left out would pass its input straight through to the next,
+    // so losing any of them is as fatal as losing the writer
+    if ((e = wcPipeAddStage(&pipe, readStage, &stages, WC_STAGE_READ)) != WC_OK ||
+        (e = wcPipeAddStage(&pipe, decodeStage, &stages, WC_STAGE_DECODE)) != WC_OK ||
+        (e = wcPipeAddStage(&pipe, cipherStage, &stages, WC_STAGE_CIPHER)) != WC_OK ||
+        (e = wcPipeAddStage(&pipe, encodeStage, &stages, WC_STAGE_ENCODE)) != WC_OK ||
+        (e = wcPipeAddStage(&pipe, writeStage, &stages, WC_STAGE_WRITE)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcPipeAddStage returned error code: %d, %s\n", e, wcerr(e));
+      exit(EXIT_FAILURE);
+    }
+    wcStatsWatchPipe(&pipe);
+    
+    if ((e = wcPipeRun(&pipe)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcPipeRun returned error code: %d, %s\n", e, wcerr(e));
+      exit(EXIT_FAILURE);
+    }
+    
+    wcPipeFree(&pipe);
+    releaseMemos(&job);
+    releaseKeys(topo, sizeof(sched), schedOfSched, (void**)job.scheds);
+    wcScheduleFree(&sched);
+    return;
   }
-  else {    // DECRYPTION
-    cipherfile = fopen(cipherpath, "r");
-    plainfile = fopen(textpath, "w");
+  
+  unsigned char* buff = wcPoolGet(pool);
+  job.buff = buff;
+  
+  // nothing has touched the buffer yet, so binding now decides where it lives
+  bindRegions(topo, prof, batch, buff, BLOCK_SIZE);
+  
+  uint64_t start = wcNow();
+  for (;;) {
     
-    // get the size of the input file
-    fseek(cipherfile, 0, SEEK_END);
-    textlen = ftell(cipherfile);
-    fseek(cipherfile, 0, SEEK_SET);
+    // read the hex strings from the given file
+    // any trailing partial block is dropped
+    uint64_t nblocks = fread(buff, 1, batch * 2*BLOCK_SIZE, infile) / (2*BLOCK_SIZE);
+    stageDone(WC_STAGE_READ, &start);
+    if (nblocks == 0) {
+      break;
+    }
     
-    // find out how many blocks to decrypt (round up)
-    blockcount = ceil((textlen/2)/BLOCK_SIZE);
+    if ((e = hexblocks_decode(buff, nblocks)) != U_OK) {
+      fprintf(stderr, "[ERR!]: hexblocks_decode returned error code: %d, %s\n", e, utilerr(e));
+      exit(EXIT_FAILURE);
+    }
+    stageDone(WC_STAGE_DECODE, &start);
+    
+    if ((e = wcEngineRun(prof->threads, prof->chunk, nblocks, ecbChunk, &job)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcEngineRun returned error code: %d, %s\n", e, wcerr(e));
+      exit(EXIT_FAILURE);
+    }
+    stageDone(WC_STAGE_CIPHER, &start);
+    
+    hexblocks_encode(buff, nblocks);
+    stageDone(WC_STAGE_ENCODE, &start);
+    
+    fwrite(buff, 1, nblocks * 2*BLOCK_SIZE, outfile);
+    stageDone(WC_STAGE_WRITE, &start);
     
-    // process every block and write it to the plaintext file
-    for (int i = 0; i < blockcount; i++) {
-
-      // read the hex strings from given files
-      fread(bstr, 1, 2*BLOCK_SIZE, cipherfile);
-      fread(kstr, 1, 2*KEY_SIZE, keyfile);
-      
-      // convert input (ciphertext) hex string to byte array
-      if ((e = hexstr_bytes(bstr, cblock, BLOCK_SIZE)) != U_OK) {
-        fprintf(stderr, "[ERR!]: hexstr_bytes returned error code: %d, %s\n", e, utilerr(e));
-        exit(EXIT_FAILURE);
-      }
-      
-      // clear out the string for temp storage
-      memset(bstr, 0, 2*BLOCK_SIZE+1);
-      
-      // convert key hex string to byte array
-      if ((e = hexstr_bytes(kstr, key, KEY_SIZE)) != U_OK) {
-        fprintf(stderr, "[ERR!]: hexstr_bytes returned error code: %d, %s\n", e, utilerr(e));
-        exit(EXIT_FAILURE);
-      }
-      
-      // pass the pblock as an arg to do a clean memcpy inside WSU-Crypt
-      // wcDecrypt returns error codes, check for errors here
-      if ((e = wcCipher(cblock, pblock, key, 'd')) != WC_OK) {
-        fprintf(stderr, "[ERR!]: wcDecrypt returned error code: %d, %s\n", e, wcerr(e));
-        exit(EXIT_FAILURE);
-      }
-      
-      // convert output (plaintext) byte array to hex string
-      if ((e = bytes_hexstr(pblock, bstr, BLOCK_SIZE)) != U_OK) {
-        fprintf(stderr, "[ERR!]: bytes_hexstr returned error code: %d, %s\n", e, utilerr(e));
-        exit(EXIT_FAILURE);
-      }
-      
-      // write the new plaintext block to the generated ciphertext file
-      fwrite(bstr, 1, 2*BLOCK_SIZE, plainfile);
 #ifdef DEBUG
-      printf("[DBUG]: wrote %s\n", bstr);
+    printf("[DBUG]: wrote %llu blocks\n", (unsigned long long)nblocks);
 #endif //DEBUG
+  }
+  
+  wcPoolPut(pool, buff);
+  releaseMemos(&job);
+  releaseKeys(topo, sizeof(sched), schedOfSched, (void**)job.scheds);
+  wcScheduleFree(&sched);
+  
+  return;
+}
+
+// arguments for authChunk(), shared by every engine worker
+typedef struct WC_AUTH_JOB {
+  WC_AUTH* ctxs[WC_MAX_NODES];      // one copy of the key per node
+  unsigned char* inbuff;
+  unsigned char* outbuff;
+  char mode;
+  uint64_t sigma[WC_MAX_THREADS];   // each worker's share of the MAC
+} WC_AUTH_JOB;
+
+// engine work function for the authenticated mode
+WC_ERR authChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_AUTH_JOB* job = arg;
+  return wcAuthChunk(job->ctxs[wcEngineNode(thread)], job->inbuff + first*BLOCK_SIZE, job->outbuff + first*BLOCK_SIZE,
+                     first, count, job->mode, &job->sigma[thread]);
+}
+
+// authenticated encryption/decryption of a whole file
+// the input is read in full so a bad tag is caught before any plaintext is written.
+// pool is set up here, with the input and output buffers, and left for the
+// caller to free
+void doAuth(WC_OPTS* opts, FILE* infile, char* outpath, char mode, WC_PROFILE* prof, WC_POOL* pool, WC_TOPO* topo) {
+  
+  int e;
+  unsigned char key[KEY_SIZE];
+  unsigned char nonce[BLOCK_SIZE];
+  uint64_t nblocks = hexFileBlocks(infile);
+  hexPoolInit(opts, pool, nblocks, 2);
+  unsigned char* inbuff = wcPoolGet(pool);
+  unsigned char* outbuff = wcPoolGet(pool);
+  nblocks = readHexBlocks(infile, inbuff, nblocks);
+  unsigned char* msg = inbuff;
+  
+  // only the raw key, the CTR and MAC subkeys are scheduled from it below
+  loadKey(opts, prof->kernel, key, NULL);
+  
+  if (mode == 'e') {
+    // fresh nonce for every message
+    FILE* rnd = fopen("/dev/urandom", "rb");
+    if (rnd == NULL || fread(nonce, 1, BLOCK_SIZE, rnd) != BLOCK_SIZE) {
+      fprintf(stderr, "[ERR!]: couldnt read a nonce from /dev/urandom\n");
+      exit(EXIT_FAILURE);
+    }
+    fclose(rnd);
+  }
+  else {
+    // split off the nonce and tag
+    if (nblocks < 2) {
+      fprintf(stderr, "[ERR!]: ciphertext too short to hold a nonce and tag\n");
+      exit(EXIT_FAILURE);
     }
+    memcpy(nonce, inbuff, BLOCK_SIZE);
+    msg = inbuff + BLOCK_SIZE;
+    nblocks -= 2;
   }
   
-  // clean up
-  fclose(keyfile);
-  fclose(plainfile);
-  fclose(cipherfile);
+  uint64_t start = wcNow();
   
-  // back to OS
-  return 0;
-}
\ No newline at end of file
+  WC_AUTH ctx;
+  if ((e = wcAuthInit(&ctx, key, nonce, nblocks)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcAuthInit returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  ctx.kernel = prof->kernel;
+  if (ctx.kernel == WC_KERN_TABLE && (e = wcAuthTables(&ctx)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcAuthTables returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  WC_STAT_ADD(0, keysetups, 1);
+  
+  WC_AUTH_JOB job;
+  memset(&job, 0, sizeof(job));
+  replicateKeys(topo, &ctx, sizeof(ctx), schedOfAuth, (void**)job.ctxs);
+  job.inbuff = msg;
+  job.outbuff = outbuff;
+  job.mode = mode;
+  
+  if ((e = wcEngineRun(prof->threads, prof->chunk, nblocks, authChunk, &job)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcEngineRun returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  
+  // combine every worker's share of the MAC
+  uint64_t sigma = 0;
+  for (int i = 0; i < WC_MAX_THREADS; i++) {
+    sigma ^= job.sigma[i];
+  }
+  stageDone(WC_STAGE_CIPHER, &start);
+  
+  // a bad tag has to be caught before the output is even opened, since
+  // opening it truncates whatever was there
+  unsigned char tag[BLOCK_SIZE];
+  if (mode == 'e') {
+    wcAuthFinal(&ctx, sigma, tag);
+  }
+  else if ((e = wcAuthVerify(&ctx, sigma, msg + nblocks*BLOCK_SIZE)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: authentication failed, ciphertext or tag was modified\n");
+    exit(EXIT_FAILURE);
+  }
+  
+  wcIndexDrop(outpath);
+  FILE* outfile = fopen(outpath, "w");
+  if (outfile == NULL) {
+    fprintf(stderr, "[ERR!]: couldnt open output file %s\n", outpath);
+    exit(EXIT_FAILURE);
+  }
+  if (mode == 'e') {
+    writeHexBlocks(outfile, nonce, 1);
+    writeHexBlocks(outfile, outbuff, nblocks);
+    writeHexBlocks(outfile, tag, 1);
+  }
+  else {
+    writeHexBlocks(outfile, outbuff, nblocks);
+  }
+  fclose(outfile);
+  
+#ifdef DEBUG
+  printf("[DBUG]: %s %llu blocks\n", (mode == 'e') ? "sealed" : "opened", (unsigned long long)nblocks);
+#endif //DEBUG
+  
+  wcPoolPut(pool, inbuff);
+  wcPoolPut(pool, outbuff);
+  releaseKeys(topo, sizeof(ctx), schedOfAuth, (void**)job.ctxs);
+  wcAuthFree(&ctx);
+  
+  return;
+}
+
+// sector mode: encrypt/decrypt a range of sectors of a raw image in place
+// workers take their scratch sectors from pool, which is set up here.
+// topo is NULL unless the workers are placed per node
+void doSector(WC_OPTS* opts, WC_POOL* pool, WC_TOPO* topo) {
+  
+  int e;
+  unsigned char key[KEY_SIZE];
+  WC_SECTOR ctx;
+  char mode = opts->mode ? 'd' : 'e';
+  
+  // the data and tweak schedules are both derived from the raw key
+  loadKey(opts, WC_NUM_KERNELS, key, NULL);
+  if ((e = wcSectorInit(&ctx, key, opts->sectorsize)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcSectorInit returned error code: %d, %s (sector size must be a multiple of %d)\n",
+            e, wcerr(e), BLOCK_SIZE);
+    exit(EXIT_FAILURE);
+  }
+  ctx.kernel = opts->prof.kernel;
+  if (ctx.kernel == WC_KERN_TABLE && (e = wcScheduleTables(&ctx.data)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcScheduleTables returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  WC_STAT_ADD(0, keysetups, 2);
+  
+  // the workers on each node use that node's copy of both schedules
+  replicateKeys(topo, &ctx, sizeof(ctx), schedOfSector, (void**)ctx.nodes);
+  
+  // one chunk of scratch sectors per worker
+  if ((e = wcPoolInit(pool, ctx.chunksectors * ctx.sectorsize, opts->prof.threads, opts->hugepages ? WC_POOL_HUGE : 0)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcPoolInit returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  wcStatsWatchPool(pool);
+  ctx.pool = pool;
+  
+  wcIndexDrop(opts->textpath);
+  int fd = open(opts->textpath, O_RDWR);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "[ERR!]: couldnt open image %s\n", opts->textpath);
+    exit(EXIT_FAILURE);
+  }
+  
+  // only whole sectors get touched
+  uint64_t total = st.st_size / opts->sectorsize;
+  if (st.st_size % opts->sectorsize != 0) {
+    fprintf(stderr, "[WARN]: image isnt a whole number of sectors, leaving the last %llu bytes alone\n",
+            (unsigned long long)(st.st_size % opts->sectorsize));
+  }
+  
+  uint64_t count = opts->sectorcount ? opts->sectorcount : total - (opts->sectorfirst < total ? opts->sectorfirst : total);
+  if (opts->sectorfirst + count > total) {
+    fprintf(stderr, "[ERR!]: sector range %llu:%llu is past the end of the image (%llu sectors)\n",
+            (unsigned long long)opts->sectorfirst, (unsigned long long)count, (unsigned long long)total);
+    exit(EXIT_FAILURE);
+  }
+  
+  uint64_t start = wcNow();
+  if ((e = wcSectorFile(&ctx, fd, opts->sectorfirst, count, mode, opts->prof.threads)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcSectorFile returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  stageDone(WC_STAGE_CIPHER, &start);
+  
+#ifdef DEBUG
+  printf("[DBUG]: %s sectors %llu to %llu\n", (mode == 'e') ? "encrypted" : "decrypted",
+         (unsigned long long)opts->sectorfirst, (unsigned long long)(opts->sectorfirst + count));
+#endif //DEBUG
+  
+  close(fd);
+  releaseKeys(topo, sizeof(ctx), schedOfSector, (void**)ctx.nodes);
+  wcSectorFree(&ctx);
+  
+  return;
+}
+
+// incremental ECB
+// keeps OUTPATH.idx with a fingerprint of every engine chunk of the input
+// and only re-ciphers the chunks that changed, patching them into the
+// existing output in place. a missing or stale index just means a full run
+// topo is NULL unless the workers are placed per node
+int doIncremental(char* inpath, char* outpath, WC_OPTS* opts, WC_POOL* pool, WC_TOPO* topo) {
+  
+  WC_ERR e;
+  unsigned char key[KEY_SIZE];
+  WC_SCHED sched;
+  struct stat st;
+  
+  loadKey(opts, opts->prof.kernel, key, &sched);
+  
+  int infd = open(inpath, O_RDONLY);
+  if (infd < 0 || fstat(infd, &st) != 0) {
+    fprintf(stderr, "[ERR!]: couldnt open input file %s\n", inpath);
+    return EXIT_FAILURE;
+  }
+  // any trailing partial block is dropped, same as the streaming path
+  uint64_t nblocks = st.st_size / (2*BLOCK_SIZE);
+  
+  int outfd = open(outpath, O_RDWR | O_CREAT, 0644);
+  if (outfd < 0 || fstat(outfd, &st) != 0) {
+    fprintf(stderr, "[ERR!]: couldnt open output file %s\n", outpath);
+    return EXIT_FAILURE;
+  }
+  
+  char idxpath[MAX_BUFF + 4];
+  snprintf(idxpath, sizeof(idxpath), "%s.idx", outpath);
+  
+  // the old index only counts for output made with this key in this
+  // direction, that nothing else has touched since
+  WC_INDEX old;
+  WC_INDEX* prev = &old;
+  char mode = opts->mode ? 'd' : 'e';
+  uint64_t keycheck = wcKeyCheck(&sched);
+  if (wcIndexLoad(idxpath, &old) != WC_OK) {
+    prev = NULL;
+  }
+  else if (old.keycheck != keycheck || old.mode != mode || !wcIndexMatches(&old, outfd)) {
+#ifdef DEBUG
+    printf("[DBUG]: index %s is for another key, direction or output, redoing everything\n", idxpath);
+#endif //DEBUG
+    wcIndexFree(&old);
+    prev = NULL;
+  }
+  
+  WC_INDEX cur;
+  if ((e = wcIndexInit(&cur, opts->prof.chunk, keycheck, nblocks, mode)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcIndexInit returned error code: %d, %s\n", e, wcerr(e));
+    return EXIT_FAILURE;
+  }
+  
+  // from here until the new index is saved the output and index disagree,
+  // so the index on disk stops counting first
+  if (wcIndexInvalidate(idxpath) != WC_OK) {
+    fprintf(stderr, "[ERR!]: couldnt invalidate index %s\n", idxpath);
+    return EXIT_FAILURE;
+  }
+  
+  // the output is exactly as long as the input, whatever it was before
+  if (ftruncate(outfd, nblocks * 2*BLOCK_SIZE) != 0) {
+    fprintf(stderr, "[ERR!]: couldnt resize output file %s\n", outpath);
+    return EXIT_FAILURE;
+  }
+  
+  if ((e = wcPoolInit(pool, opts->prof.chunk * 2*BLOCK_SIZE, opts->prof.threads, opts->hugepages ? WC_POOL_HUGE : 0)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcPoolInit returned error code: %d, %s\n", e, wcerr(e));
+    return EXIT_FAILURE;
+  }
+  wcStatsWatchPool(pool);
+  
+  WC_INCR ctx;
+  ctx.sched = &sched;
+  ctx.kernel = opts->prof.kernel;
+  ctx.mode = mode;
+  ctx.pool = pool;
+  replicateKeys(topo, &sched, sizeof(sched), schedOfSched, (void**)ctx.scheds);
+  
+  uint64_t changed;
+  uint64_t start = wcNow();
+  if ((e = wcIncrFile(&ctx, infd, outfd, prev, &cur, opts->prof.threads, &changed)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcIncrFile returned error code: %d, %s\n", e, wcerr(e));
+    return EXIT_FAILURE;
+  }
+  stageDone(WC_STAGE_CIPHER, &start);
+  
+  // the output has to be on disk before the index says its up to date
+  if (fsync(outfd) != 0 || wcIndexStamp(&cur, outfd) != WC_OK || (e = wcIndexSave(idxpath, &cur)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: couldnt write index %s\n", idxpath);
+    return EXIT_FAILURE;
+  }
+  stageDone(WC_STAGE_WRITE, &start);
+  
+#ifdef DEBUG
+  printf("[DBUG]: rewrote %llu of %llu chunks\n", (unsigned long long)changed, (unsigned long long)cur.nchunks);
+#endif //DEBUG
+  
+  close(infd);
+  close(outfd);
+  wcIndexFree(&cur);
+  if (prev != NULL) {
+    wcIndexFree(prev);
+  }
+  releaseKeys(topo, sizeof(sched), schedOfSched, (void**)ctx.scheds);
+  wcScheduleFree(&sched);
+  
+  return EXIT_SUCCESS;
+}
+
+// files in flight for the CBC batch. enough to keep every lane busy while
+// finished files are written out and new ones read in
+#define CBC_WINDOW (2 * WC_MB_LANES)
+
+// one file in the CBC batch
+typedef struct WC_CBC_FILE {
+  WC_MB_STREAM stream;
+  char outpath[MAX_BUFF];
+  unsigned char* buff;      // plaintext, encrypted in place. from the batch's pool
+} WC_CBC_FILE;
+
+// state for the whole CBC batch
+typedef struct WC_CBC_BATCH {
+  WC_MBUF mb;
+  WC_POOL* pool;            // a buffer for every file in flight
+  uint64_t most;            // blocks in the biggest file, what each buffer holds
+  char** paths;
+  int npaths;
+  int next;                 // next file to load
+} WC_CBC_BATCH;
+
+// read the next file of the batch and queue it for a lane
+void cbcLoadNext(WC_CBC_BATCH* batch) {
+  if (batch->next >= batch->npaths) {
+    return;
+  }
+  
+  char* path = batch->paths[batch->next++];
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "[ERR!]: couldnt open input file %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  
+  WC_CBC_FILE* cf = calloc(1, sizeof(WC_CBC_FILE));
+  FILE* rnd = fopen("/dev/urandom", "rb");
+  if (cf == NULL || rnd == NULL || fread(cf->stream.iv, 1, BLOCK_SIZE, rnd) != BLOCK_SIZE) {
+    fprintf(stderr, "[ERR!]: couldnt set up %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  fclose(rnd);
+  
+  cf->buff = wcPoolGet(batch->pool);
+  cf->stream.nblocks = readHexBlocks(f, cf->buff, batch->most);
+  fclose(f);
+  
+  cf->stream.inbuff = cf->buff;
+  cf->stream.outbuff = cf->buff;
+  cf->stream.user = cf;
+  snprintf(cf->outpath, MAX_BUFF, "%s.cbc", path);
+  
+  wcMbSubmit(&batch->mb, &cf->stream);
+  
+  return;
+}
+
+// a file finished encrypting: write IV and ciphertext, then start another
+void cbcDone(WC_MB_STREAM* stream, void* arg) {
+  WC_CBC_BATCH* batch = arg;
+  WC_CBC_FILE* cf = stream->user;
+  
+  wcIndexDrop(cf->outpath);
+  FILE* f = fopen(cf->outpath, "w");
+  if (f == NULL) {
+    fprintf(stderr, "[ERR!]: couldnt open output file %s\n", cf->outpath);
+    exit(EXIT_FAILURE);
+  }
+  writeHexBlocks(f, stream->iv, 1);
+  writeHexBlocks(f, cf->buff, stream->nblocks);
+  fclose(f);
+  
+  WC_STAT_ADD(0, blocks, stream->nblocks);
+  
+#ifdef DEBUG
+  printf("[DBUG]: wrote %s (%llu blocks)\n", cf->outpath, (unsigned long long)stream->nblocks);
+#endif //DEBUG
+  
+  wcPoolPut(batch->pool, cf->buff);
+  free(cf);
+  
+  cbcLoadNext(batch);
+  
+  return;
+}
+
+// wsucrypt cbc: CBC encrypt or decrypt every file named on the command line
+// encryption interleaves the files through the multi-buffer scheduler,
+// decryption is already parallel inside each file so it goes one at a time.
+// both run on the calling thread alone, so theres nothing for --numa to place.
+// pool is set up here and left for the caller to free
+int doCBC(WC_OPTS* opts, WC_POOL* pool) {
+  
+  int e;
+  unsigned char key[KEY_SIZE];
+  WC_SCHED sched;
+  
+  // files[0] is the subcommand itself
+  char** paths = opts->files + 1;
+  int npaths = opts->nfiles - 1;
+  if (npaths < 1 || opts->mode == -1) {
+    fprintf(stderr, "[ERR!]: usage: wsucrypt cbc -k KEY (-e|-d) FILE...\n");
+    return EXIT_FAILURE;
+  }
+  
+  loadKey(opts, opts->prof.kernel, key, &sched);
+  
+  // every buffer is sized for the biggest file
+  uint64_t most = 0;
+  for (int i = 0; i < npaths; i++) {
+    FILE* f = fopen(paths[i], "r");
+    if (f == NULL) {
+      fprintf(stderr, "[ERR!]: couldnt open input file %s\n", paths[i]);
+      return EXIT_FAILURE;
+    }
+    uint64_t n = hexFileBlocks(f);
+    most = (n > most) ? n : most;
+    fclose(f);
+  }
+  
+  // one buffer per file in flight when encrypting, the input and output
+  // of the one file when decrypting
+  unsigned int window = (npaths < CBC_WINDOW) ? npaths : CBC_WINDOW;
+  hexPoolInit(opts, pool, most, opts->mode ? 2 : window);
+  
+  uint64_t start = wcNow();
+  
+  if (!opts->mode) {
+    WC_CBC_BATCH batch;
+    batch.pool = pool;
+    batch.most = most;
+    batch.paths = paths;
+    batch.npaths = npaths;
+    batch.next = 0;
+    wcMbInit(&batch.mb, &sched, opts->prof.kernel, cbcDone, &batch);
+    
+    for (int i = 0; i < CBC_WINDOW; i++) {
+      cbcLoadNext(&batch);
+    }
+    if ((e = wcMbFlush(&batch.mb)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcMbFlush returned error code: %d, %s\n", e, wcerr(e));
+      return EXIT_FAILURE;
+    }
+    
+#ifdef DEBUG
+    printf("[DBUG]: %llu kernel calls, %.2f of %d lanes busy on average\n", (unsigned long long)batch.mb.steps,
+           batch.mb.steps ? (double)batch.mb.laneblocks / batch.mb.steps : 0.0, WC_MB_LANES);
+#endif //DEBUG
+  }
+  else {
+    for (int i = 0; i < npaths; i++) {
+      FILE* f = fopen(paths[i], "r");
+      if (f == NULL) {
+        fprintf(stderr, "[ERR!]: couldnt open input file %s\n", paths[i]);
+        return EXIT_FAILURE;
+      }
+      unsigned char* in = wcPoolGet(pool);
+      unsigned char* out = wcPoolGet(pool);
+      uint64_t nblocks = readHexBlocks(f, in, most);
+      fclose(f);
+      if (nblocks < 1) {
+        fprintf(stderr, "[ERR!]: %s is too short to hold an IV\n", paths[i]);
+        return EXIT_FAILURE;
+      }
+      nblocks--;
+      
+      if ((e = wcCbcDecrypt(opts->prof.kernel, &sched, in, in + BLOCK_SIZE, out, nblocks)) != WC_OK) {
+        fprintf(stderr, "[ERR!]: wcCbcDecrypt returned error code: %d, %s\n", e, wcerr(e));
+        return EXIT_FAILURE;
+      }
+      WC_STAT_ADD(0, blocks, nblocks);
+      
+      // FILE.cbc decrypts to FILE, anything else to FILE.dec
+      char outpath[MAX_BUFF];
+      size_t len = strlen(paths[i]);
+      if (len > 4 && strcmp(paths[i] + len - 4, ".cbc") == 0) {
+        snprintf(outpath, MAX_BUFF, "%.*s", (int)(len - 4), paths[i]);
+      }
+      else {
+        snprintf(outpath, MAX_BUFF, "%s.dec", paths[i]);
+      }
+      
+      wcIndexDrop(outpath);
+      if ((f = fopen(outpath, "w")) == NULL) {
+        fprintf(stderr, "[ERR!]: couldnt open output file %s\n", outpath);
+        return EXIT_FAILURE;
+      }
+      writeHexBlocks(f, out, nblocks);
+      fclose(f);
+      
+      wcPoolPut(pool, in);
+      wcPoolPut(pool, out);
+    }
+  }
+  stageDone(WC_STAGE_CIPHER, &start);
+  
+  wcScheduleFree(&sched);
+  
+  return EXIT_SUCCESS;
+}
+
+// fill in any engine settings not given on the command line, first from
+// the profile and then from the defaults, so command line options always win
+void resolveProfile(WC_OPTS* opts) {
+  
+  WC_PROFILE base;
+  wcProfileDefaults(&base);
+  
+  if (opts->profilepath[0] == '\0') {
+    wcProfilePath(opts->profilepath, MAX_BUFF);
+  }
+  if (wcProfileLoad(opts->profilepath, &base) == WC_OK) {
+#ifdef DEBUG
+    printf("[DBUG]: loaded profile %s\n", opts->profilepath);
+#endif //DEBUG
+  }
+  
+  if (opts->prof.kernel == WC_NUM_KERNELS) {
+    opts->prof.kernel = base.kernel;
+  }
+  if (opts->prof.threads == 0) {
+    opts->prof.threads = base.threads;
+  }
+  if (opts->prof.chunk == 0) {
+    opts->prof.chunk = base.chunk;
+  }
+  if (opts->prof.batch == 0) {
+    opts->prof.batch = base.batch;
+  }
+  
+  // the reference kernel works through the globals
+  if (opts->prof.kernel == WC_KERN_REF && opts->prof.threads > 1) {
+    fprintf(stderr, "[WARN]: the ref kernel is single threaded, ignoring --threads\n");
+    opts->prof.threads = 1;
+  }
+  
+  return;
+}
+
+// wsucrypt tune: benchmark this host and save the winners to the profile
+int doTune(WC_OPTS* opts) {
+  
+  WC_ERR e;
+  WC_PROFILE prof;
+  wcProfileDefaults(&prof);
+  
+  if (opts->profilepath[0] == '\0' && wcProfilePath(opts->profilepath, MAX_BUFF) != WC_OK) {
+    fprintf(stderr, "[ERR!]: no profile path, set $%s or use -p\n", WC_PROFILE_ENV);
+    return EXIT_FAILURE;
+  }
+  
+  if ((e = wcTune(&prof, 1)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcTune returned error code: %d, %s\n", e, wcerr(e));
+    return EXIT_FAILURE;
+  }
+  
+  if ((e = wcProfileSave(opts->profilepath, &prof)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: couldnt write profile %s\n", opts->profilepath);
+    return EXIT_FAILURE;
+  }
+  
+  printf("saved %s: kernel=%s threads=%u chunk=%llu batch=%llu\n", opts->profilepath,
+         wcKernelName(prof.kernel), prof.threads, (unsigned long long)prof.chunk, (unsigned long long)prof.batch);
+  
+  return EXIT_SUCCESS;
+}
+
+// cryptanalysis subcommand
+// topo is NULL unless the sampling workers are placed per node
+int doAnalyze(WC_OPTS* opts, WC_TOPO* topo) {
+  
+  WC_ERR e;
+  
+  // files[0] is the subcommand itself
+  char* what = (opts->nfiles > 1) ? opts->files[1] : "";
+  
+  if (strcmp(what, "sbox") == 0) {
+    wcSboxReport(stdout, FTABLE);
+    return EXIT_SUCCESS;
+  }
+  
+  // full tables, one row per input difference/mask
+  if (strcmp(what, "ddt") == 0 || strcmp(what, "lat") == 0) {
+    static uint16_t ddt[256][256];
+    static int16_t lat[256][256];
+    int isddt = (what[0] == 'd');
+    if (isddt) {
+      wcDDT(FTABLE, ddt);
+    }
+    else {
+      wcLAT(FTABLE, lat);
+    }
+    for (int a = 0; a < 256; a++) {
+      for (int b = 0; b < 256; b++) {
+        printf(b ? " %d" : "%d", isddt ? ddt[a][b] : lat[a][b]);
+      }
+      printf("\n");
+    }
+    return EXIT_SUCCESS;
+  }
+  
+  WC_TRAIL trail;
+  memset(&trail, 0, sizeof(trail));
+  if (strcmp(what, "diff") == 0) {
+    trail.kind = WC_TRAIL_DIFF;
+  }
+  else if (strcmp(what, "linear") == 0) {
+    trail.kind = WC_TRAIL_LINEAR;
+  }
+  else {
+    fprintf(stderr, "[ERR!]: usage: wsucrypt analyze (sbox|ddt|lat) or wsucrypt analyze (diff|linear) ROUNDS IN OUT [SAMPLES]\n");
+    return EXIT_FAILURE;
+  }
+  
+  if (opts->nfiles < 5) {
+    fprintf(stderr, "[ERR!]: usage: wsucrypt analyze %s ROUNDS IN OUT [SAMPLES]\n", what);
+    return EXIT_FAILURE;
+  }
+  trail.rounds = atoi(opts->files[2]);
+  trail.in = strtoull(opts->files[3], NULL, 16);
+  trail.out = strtoull(opts->files[4], NULL, 16);
+  trail.samples = (opts->nfiles > 5) ? strtoull(opts->files[5], NULL, 0) : (1ULL << 24);
+  if (trail.rounds < 1 || trail.rounds > NUM_ROUNDS) {
+    fprintf(stderr, "[ERR!]: ROUNDS must be 1 to %d\n", NUM_ROUNDS);
+    return EXIT_FAILURE;
+  }
+  
+  // fresh inputs every run
+  FILE* rnd = fopen("/dev/urandom", "rb");
+  if (rnd == NULL || fread(&trail.seed, 1, sizeof(trail.seed), rnd) != sizeof(trail.seed)) {
+    fprintf(stderr, "[ERR!]: couldnt read a seed from /dev/urandom\n");
+    exit(EXIT_FAILURE);
+  }
+  fclose(rnd);
+  
+  unsigned char key[KEY_SIZE];
+  WC_SCHED sched;
+  loadKey(opts, WC_NUM_KERNELS, key, &sched);
+  WC_SCHED* scheds[WC_MAX_NODES];
+  replicateKeys(topo, &sched, sizeof(sched), schedOfSched, (void**)scheds);
+  
+  uint64_t start = wcNow();
+  if ((e = wcTrailSample(scheds, &trail, opts->prof.threads, opts->prof.chunk)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcTrailSample returned error code: %d, %s\n", e, wcerr(e));
+    return EXIT_FAILURE;
+  }
+  stageDone(WC_STAGE_CIPHER, &start);
+  
+  wcTrailReport(stdout, &trail);
+  releaseKeys(topo, sizeof(sched), schedOfSched, (void**)scheds);
+  
+  return EXIT_SUCCESS;
+}
+
+// set up an auth context for a manifest, checking the key is the right one
+void shardContext(WC_OPTS* opts, WC_MANIFEST* m, WC_AUTH* ctx) {
+  
+  WC_ERR e;
+  unsigned char key[KEY_SIZE];
+  unsigned char nonce[BLOCK_SIZE];
+  
+  // the master schedule is only for the key check, the context schedules
+  // its own subkeys
+  WC_SCHED sched;
+  loadKey(opts, WC_NUM_KERNELS, key, &sched);
+  if (m->keycheck != wcKeyCheck(&sched)) {
+    fprintf(stderr, "[ERR!]: key %s isnt the one the manifest was made with\n", opts->keypath);
+    exit(EXIT_FAILURE);
+  }
+  wcScheduleFree(&sched);
+  
+  u64_bytes(m->nonce, nonce);
+  if ((e = wcAuthInit(ctx, key, nonce, m->nblocks)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcAuthInit returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  ctx->kernel = opts->prof.kernel;
+  if (ctx->kernel == WC_KERN_TABLE && (e = wcAuthTables(ctx)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcAuthTables returned error code: %d, %s\n", e, wcerr(e));
+    exit(EXIT_FAILURE);
+  }
+  
+  return;
+}
+
+// wsucrypt shard plan N / wsucrypt shard work MANIFEST I
+// planning just writes OUTPUT.manifest, nothing is encrypted until the
+// workers run, wherever they run. every worker needs the same key and its
+// own copy of the input at the path in the manifest
+int doShard(WC_OPTS* opts) {
+  
+  WC_ERR e;
+  struct stat st;
+  
+  // the manifest is too big for the stack
+  WC_MANIFEST* m = malloc(sizeof(WC_MANIFEST));
+  if (m == NULL) {
+    fprintf(stderr, "[ERR!]: out of memory\n");
+    return EXIT_FAILURE;
+  }
+  memset(m, 0, sizeof(WC_MANIFEST));
+  
+  // files[0] is the subcommand itself
+  char* what = (opts->nfiles > 1) ? opts->files[1] : "";
+  
+  if (strcmp(what, "plan") == 0 && opts->nfiles > 2) {
+    snprintf(m->input, MAX_BUFF, "%s", opts->textpath);
+    snprintf(m->output, MAX_BUFF, "%s", opts->cipherpath);
+    if (stat(m->input, &st) != 0) {
+      fprintf(stderr, "[ERR!]: couldnt open input file %s\n", m->input);
+      return EXIT_FAILURE;
+    }
+    m->inputsize = st.st_size;
+    
+    // any trailing partial block is dropped, same as the other modes
+    if ((e = wcManifestPlan(m, m->inputsize / (2*BLOCK_SIZE), atoi(opts->files[2]))) != WC_OK) {
+      fprintf(stderr, "[ERR!]: N must be 1 to %d\n", WC_MAX_SHARDS);
+      return EXIT_FAILURE;
+    }
+    if ((e = wcManifestSums(m)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: couldnt read input file %s\n", m->input);
+      return EXIT_FAILURE;
+    }
+    
+    // fresh nonce for every message, same as doAuth()
+    unsigned char nonce[BLOCK_SIZE];
+    FILE* rnd = fopen("/dev/urandom", "rb");
+    if (rnd == NULL || fread(nonce, 1, BLOCK_SIZE, rnd) != BLOCK_SIZE) {
+      fprintf(stderr, "[ERR!]: couldnt read a nonce from /dev/urandom\n");
+      exit(EXIT_FAILURE);
+    }
+    fclose(rnd);
+    m->nonce = bytes_u64(nonce);
+    
+    unsigned char key[KEY_SIZE];
+    WC_SCHED sched;
+    loadKey(opts, WC_NUM_KERNELS, key, &sched);
+    m->keycheck = wcKeyCheck(&sched);
+    
+    char path[MAX_BUFF + 16];
+    snprintf(path, sizeof(path), "%s.manifest", m->output);
+    if ((e = wcManifestSave(path, m)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: couldnt write manifest %s\n", path);
+      return EXIT_FAILURE;
+    }
+    printf("%s\n", path);
+  }
+  else if (strcmp(what, "work") == 0 && opts->nfiles > 3) {
+    if (wcManifestLoad(opts->files[2], m) != WC_OK) {
+      fprintf(stderr, "[ERR!]: couldnt read manifest %s\n", opts->files[2]);
+      return EXIT_FAILURE;
+    }
+    unsigned int i = atoi(opts->files[3]);
+    if (i >= m->nshards) {
+      fprintf(stderr, "[ERR!]: the manifest only has shards 0 to %u\n", m->nshards - 1);
+      return EXIT_FAILURE;
+    }
+    
+    WC_AUTH ctx;
+    shardContext(opts, m, &ctx);
+    
+    uint64_t start = wcNow();
+    if ((e = wcShardRun(m, i, &ctx, opts->prof.threads, opts->prof.chunk, opts->prof.batch)) == WC_BAD_SRC_BLOCK) {
+      fprintf(stderr, "[ERR!]: %s isnt the input the manifest was planned from\n", m->input);
+      return EXIT_FAILURE;
+    }
+    if (e != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcShardRun returned error code: %d, %s\n", e, wcerr(e));
+      return EXIT_FAILURE;
+    }
+    stageDone(WC_STAGE_CIPHER, &start);
+    wcAuthFree(&ctx);
+  }
+  else {
+    fprintf(stderr, "[ERR!]: usage: wsucrypt shard plan N or wsucrypt shard work MANIFEST I\n");
+    return EXIT_FAILURE;
+  }
+  
+  free(m);
+  
+  return EXIT_SUCCESS;
+}
+
+// wsucrypt merge MANIFEST
+int doMerge(WC_OPTS* opts) {
+  
+  WC_ERR e;
+  
+  if (opts->nfiles < 2) {
+    fprintf(stderr, "[ERR!]: usage: wsucrypt merge MANIFEST\n");
+    return EXIT_FAILURE;
+  }
+  
+  WC_MANIFEST* m = malloc(sizeof(WC_MANIFEST));
+  if (m == NULL) {
+    fprintf(stderr, "[ERR!]: out of memory\n");
+    return EXIT_FAILURE;
+  }
+  if (wcManifestLoad(opts->files[1], m) != WC_OK) {
+    fprintf(stderr, "[ERR!]: couldnt read manifest %s\n", opts->files[1]);
+    return EXIT_FAILURE;
+  }
+  
+  WC_AUTH ctx;
+  shardContext(opts, m, &ctx);
+  
+  unsigned int missing;
+  uint64_t start = wcNow();
+  wcIndexDrop(m->output);
+  if ((e = wcShardMerge(m, &ctx, &missing)) != WC_OK) {
+    if (missing < m->nshards) {
+      char path[MAX_BUFF + 16];
+      wcShardPath(m, missing, path, sizeof(path));
+      fprintf(stderr, "[ERR!]: shard %u (%s) is missing, incomplete or from another manifest\n", missing, path);
+    }
+    else {
+      fprintf(stderr, "[ERR!]: couldnt write %s\n", m->output);
+    }
+    return EXIT_FAILURE;
+  }
+  stageDone(WC_STAGE_WRITE, &start);
+  
+  wcAuthFree(&ctx);
+  free(m);
+  
+  return EXIT_SUCCESS;
+}
+
+// wsucrypt keystore build STORE ID=KEYFILE... / wsucrypt keystore list|verify STORE
+// the G tables go in the store when the kernel (-K or the profile) uses them
+int doKeyStore(WC_OPTS* opts) {
+  
+  WC_ERR e;
+  char* what = (opts->nfiles > 1) ? opts->files[1] : "";
+  
+  if (strcmp(what, "build") == 0 && opts->nfiles > 3) {
+    int n = opts->nfiles - 3;
+    char** ids = opts->files + 3;
+    unsigned char (*keys)[KEY_SIZE] = malloc(n * sizeof(*keys));
+    if (keys == NULL) {
+      fprintf(stderr, "[ERR!]: out of memory\n");
+      return EXIT_FAILURE;
+    }
+    
+    // split each ID=KEYFILE in place, ids keeps just the IDs
+    for (int i = 0; i < n; i++) {
+      char* eq = strchr(ids[i], '=');
+      if (eq == NULL || eq == ids[i]) {
+        fprintf(stderr, "[ERR!]: bad key %s, use ID=KEYFILE\n", ids[i]);
+        return EXIT_FAILURE;
+      }
+      *eq = '\0';
+      FILE* keyfile = fopen(eq + 1, "r");
+      if (keyfile == NULL) {
+        fprintf(stderr, "[ERR!]: couldnt open key file %s\n", eq + 1);
+        return EXIT_FAILURE;
+      }
+      readKey(keyfile, keys[i]);
+      fclose(keyfile);
+    }
+    
+    uint64_t start = wcNow();
+    if ((e = wcKeyStoreWrite(opts->files[2], ids, keys, n, opts->prof.kernel == WC_KERN_TABLE)) != WC_OK) {
+      fprintf(stderr, "[ERR!]: wcKeyStoreWrite returned error code: %d, %s (IDs must be unique and under %d characters)\n",
+              e, wcerr(e), WC_KEYID_MAX);
+      return EXIT_FAILURE;
+    }
+    WC_STAT_ADD(0, keysetups, n);
+    stageDone(WC_STAGE_WRITE, &start);
+    
+    free(keys);
+  }
+  else if (strcmp(what, "list") == 0 && opts->nfiles > 2) {
+    WC_KEYSTORE ks;
+    if (wcKeyStoreOpen(opts->files[2], &ks) != WC_OK) {
+      fprintf(stderr, "[ERR!]: couldnt open key store %s, or it was written by a different build\n", opts->files[2]);
+      return EXIT_FAILURE;
+    }
+    wcKeyStoreList(stdout, &ks);
+    wcKeyStoreClose(&ks);
+  }
+  else if (strcmp(what, "verify") == 0 && opts->nfiles > 2) {
+    // every table summed, which loading a key skips
+    WC_KEYSTORE ks;
+    uint32_t bad;
+    if (wcKeyStoreOpen(opts->files[2], &ks) != WC_OK) {
+      fprintf(stderr, "[ERR!]: couldnt open key store %s, or it was written by a different build\n", opts->files[2]);
+      return EXIT_FAILURE;
+    }
+    if (wcKeyStoreVerify(&ks, &bad) != WC_OK) {
+      fprintf(stderr, "[ERR!]: key %.*s in %s is damaged\n", WC_KEYID_MAX, ks.dir[bad].id, opts->files[2]);
+      wcKeyStoreClose(&ks);
+      return EXIT_FAILURE;
+    }
+    printf("%s: %u keys ok\n", opts->files[2], ks.hdr->count);
+    wcKeyStoreClose(&ks);
+  }
+  else {
+    fprintf(stderr, "[ERR!]: usage: wsucrypt keystore build STORE ID=KEYFILE... or wsucrypt keystore list|verify STORE\n");
+    return EXIT_FAILURE;
+  }
+  
+  return EXIT_SUCCESS;
+}
+
+// statistical quality subcommand
+int doAvalanche(WC_OPTS* opts) {
+  
+  WC_ERR e;
+  
+  // files[0] is the subcommand itself
+  uint64_t samples = (opts->nfiles > 1) ? strtoull(opts->files[1], NULL, 0) : (1ULL << 16);
+  
+  // fresh plaintexts and keys every run
+  uint64_t seed;
+  FILE* rnd = fopen("/dev/urandom", "rb");
+  if (rnd == NULL || fread(&seed, 1, sizeof(seed), rnd) != sizeof(seed)) {
+    fprintf(stderr, "[ERR!]: couldnt read a seed from /dev/urandom\n");
+    exit(EXIT_FAILURE);
+  }
+  fclose(rnd);
+  
+  // the counts are about 100KB, keep them off the stack
+  WC_QUALITY* q = malloc(sizeof(WC_QUALITY));
+  if (q == NULL) {
+    fprintf(stderr, "[ERR!]: out of memory\n");
+    return EXIT_FAILURE;
+  }
+  
+  uint64_t start = wcNow();
+  if ((e = wcQualityRun(opts->prof.kernel, samples, seed, opts->prof.threads, opts->prof.chunk, q)) != WC_OK) {
+    fprintf(stderr, "[ERR!]: wcQualityRun returned error code: %d, %s\n", e, wcerr(e));
+    free(q);
+    return EXIT_FAILURE;
+  }
+  stageDone(WC_STAGE_CIPHER, &start);
+  
+  int pass = wcQualityReport(stdout, q);
+  free(q);
+  
+  return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// entry point
+int main(int argc, char** argv) {
+  // too few args
+  if (argc < 2) {
+    
+#ifdef DEBUG
+  printf("[DBUG]: no args\n");
+#endif //DEBUG
+    
+    printHelp();
+    exit(EXIT_FAILURE);
+  }
+  
+  // settings passed from command line
+  WC_OPTS opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.mode = -1;
+  opts.prof.kernel = WC_NUM_KERNELS;
+  opts.files = calloc(argc, sizeof(char*));
+  
+  // default filenames for assignment
+  strcpy(opts.keypath, "key.txt");
+  strcpy(opts.textpath, "plaintext.txt");
+  strcpy(opts.cipherpath, "ciphertext.txt");
+  
+  // parse arguments into locals
+  parseArgs(argc, argv, &opts);
+  
+  // topology report
+  static WC_TOPO topo;
+  if (opts.topology || opts.numa) {
+    wcTopoInit(&topo);
+  }
+  if (opts.topology) {
+    wcTopoReport(stdout, &topo);
+    return EXIT_SUCCESS;
+  }
+  
+  // subcommands
+  if (strcmp("tune", argv[1]) == 0) {
+    return doTune(&opts);
+  }
+  
+  resolveProfile(&opts);
+  
+  if (strcmp("cbc", argv[1]) == 0) {
+    wcStatsInit();
+    WC_POOL pool;
+    memset(&pool, 0, sizeof(pool));
+    int ret = doCBC(&opts, &pool);
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    wcStatsWatchPool(NULL);
+    wcPoolFree(&pool);
+    return ret;
+  }
+  
+  if (strcmp("shard", argv[1]) == 0 || strcmp("merge", argv[1]) == 0) {
+    wcStatsInit();
+    int ret = (argv[1][0] == 's') ? doShard(&opts) : doMerge(&opts);
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    return ret;
+  }
+  
+  if (strcmp("keystore", argv[1]) == 0) {
+    wcStatsInit();
+    int ret = doKeyStore(&opts);
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    return ret;
+  }
+  
+  if (strcmp("avalanche", argv[1]) == 0) {
+    wcStatsInit();
+    int ret = doAvalanche(&opts);
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    return ret;
+  }
+  
+  if (strcmp("analyze", argv[1]) == 0) {
+    wcStatsInit();
+    if (opts.numa) {
+      wcEngineSetTopo(&topo);
+    }
+    int ret = doAnalyze(&opts, opts.numa ? &topo : NULL);
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    return ret;
+  }
+  
+  // if we didnt get a mode, error out
+  if (opts.mode == -1) {
+    fprintf(stderr, "[ERR!]: failed to supply mode. use -e (--encrypt) or -d (--decrypt).\n");
+    exit(EXIT_FAILURE);
+  }
+  
+#ifdef DEBUG
+  printf("[DBUG]: parsed args:\n key = %s\n text = %s\n mode = %s\n auth = %d\n kernel = %s\n threads = %u\n chunk = %llu\n batch = %llu\n",
+         opts.keypath, opts.textpath, opts.mode?"decrypt":"encrypt", opts.auth, wcKernelName(opts.prof.kernel),
+         opts.prof.threads, (unsigned long long)opts.prof.chunk, (unsigned long long)opts.prof.batch);
+#endif //DEBUG
+  
+  // start counting before any files get touched
+  wcStatsInit();
+  if (opts.stats && opts.interval) {
+    wcStatsStartTimer(stderr, opts.interval);
+  }
+  
+  // workers get pinned from here on, so every run below is placed per node
+  if (opts.numa) {
+    wcEngineSetTopo(&topo);
+  }
+  
+  // encryption reads the plaintext and writes the ciphertext, decryption the other way around
+  char* inpath = opts.mode ? opts.cipherpath : opts.textpath;
+  char* outpath = opts.mode ? opts.textpath : opts.cipherpath;
+  
+  // buffers for the run, set up by whichever mode uses them
+  WC_POOL pool;
+  memset(&pool, 0, sizeof(pool));
+  
+  // sector mode rewrites the image in place instead of making a new file
+  if (opts.sectorsize) {
+    doSector(&opts, &pool, opts.numa ? &topo : NULL);
+    wcStatsStopTimer();
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    wcStatsWatchPool(NULL);
+    wcPoolFree(&pool);
+    return 0;
+  }
+  // incremental mode patches the existing output instead of rewriting it
+  if (opts.incremental) {
+    if (opts.auth) {
+      fprintf(stderr, "[ERR!]: incremental mode is ECB only, CTR would reuse counters on changed blocks\n");
+      exit(EXIT_FAILURE);
+    }
+    int ret = doIncremental(inpath, outpath, &opts, &pool, opts.numa ? &topo : NULL);
+    wcStatsStopTimer();
+    if (opts.stats) {
+      wcStatsReport(stderr, 1);
+    }
+    wcStatsWatchPool(NULL);
+    wcPoolFree(&pool);
+    return ret;
+  }
+  
+  FILE* infile = fopen(inpath, "r");
+  if (infile == NULL) {
+    fprintf(stderr, "[ERR!]: couldnt open input file %s\n", inpath);
+    exit(EXIT_FAILURE);
+  }
+  
+  // do the operation
+  if (opts.auth) {
+    // authenticated mode works on the whole file at once, and opens the
+    // output itself once the tag has checked out
+    doAuth(&opts, infile, outpath, opts.mode ? 'd' : 'e', &opts.prof, &pool, opts.numa ? &topo : NULL);
+  }
+  else {
+    // a full run leaves any incremental index behind it stale
+    wcIndexDrop(outpath);
+    FILE* outfile = fopen(outpath, "w");
+    if (outfile == NULL) {
+      fprintf(stderr, "[ERR!]: couldnt open output file %s\n", outpath);
+      exit(EXIT_FAILURE);
+    }
+    doECB(&opts, infile, outfile, opts.mode ? 'd' : 'e', &opts.prof, &pool, opts.hugepages ? WC_POOL_HUGE : 0, opts.numa ? &topo : NULL);
+    fclose(outfile);
+  }
+  
+  // clean up
+  fclose(infile);
+  
+  wcStatsStopTimer();
+  if (opts.stats) {
+    wcStatsReport(stderr, 1);
+  }
+  wcStatsWatchPool(NULL);
+  wcPoolFree(&pool);
+  
+  // back to OS
+  return 0;
+}
@@ -16,11 +16,15 @@
 //  implementation of utility functions
 
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "util.h"
 
@@ -41,6 +45,9 @@ char* utilerr(UTIL_ERR errcode) {
   case U_BAD_CHAR:
     estr = "BAD_CHAR";
     break;
+  case U_BAD_IO:
+    estr = "BAD_IO";
+    break;
   case U_UNKNOWN: // intentionally fall through to default
   default:
     break;
@@ -61,7 +68,7 @@ unsigned short bswap16(unsigned short in) {
 
 // bitwise rotate a byte array right
 void rrotate(unsigned char* array, unsigned int size, unsigned int shift) {
-
+  
   // store the original size
   unsigned int osize = size;
   
@@ -126,6 +133,61 @@ unsigned short catbytes(unsigned char b1, unsigned char b2) {
   return ((b1 << 8) | b2);
 }
 
+// pack 8 bytes into a 64bit word, first byte most significant
+// (same order the blocks are written in the hex strings)
+uint64_t bytes_u64(unsigned char* bytes) {
+  uint64_t ret = 0;
+  for (int i = 0; i < 8; i++) {
+    ret = (ret << 8) | bytes[i];
+  }
+  return ret;
+}
+
+// unpack a 64bit word into 8 bytes, most significant first
+void u64_bytes(uint64_t in, unsigned char* bytes) {
+  for (int i = 7; i >= 0; i--) {
+    bytes[i] = in & 0xFF;
+    in >>= 8;
+  }
+  return;
+}
+
+// multiply by x in GF(2^64) mod x^64 + x^4 + x^3 + x + 1
+uint64_t gf64_dbl(uint64_t in) {
+  return (in << 1) ^ ((in >> 63) ? 0x1B : 0);
+}
+
+// divide by x in GF(2^64) mod x^64 + x^4 + x^3 + x + 1
+// (if the low bit is set, add the polynomial first so it divides evenly)
+uint64_t gf64_half(uint64_t in) {
+  return (in >> 1) ^ ((in & 1) ? 0x800000000000000DULL : 0);
+}
+
+// splitmix64 finalizer
+uint64_t mix64(uint64_t in) {
+  in += 0x9E3779B97F4A7C15ULL;
+  in = (in ^ (in >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  in = (in ^ (in >> 27)) * 0x94D049BB133111EBULL;
+  return in ^ (in >> 31);
+}
+
+// unkeyed 64bit checksum of len bytes
+// eight bytes at a time through the splitmix64 finalizer, seeded with the
+// length so inputs of different sizes never match
+uint64_t fingerprint64(unsigned char* data, size_t len) {
+  uint64_t h = mix64(len);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    h = mix64(h ^ bytes_u64(data + i));
+  }
+  if (i < len) {
+    unsigned char tail[8] = {0};
+    memcpy(tail, data + i, len - i);
+    h = mix64(h ^ bytes_u64(tail));
+  }
+  return h;
+}
+
 // format and return an index for the ftable
 unsigned char ftable_index(unsigned char in) {
   unsigned char ret;
@@ -135,6 +197,20 @@ unsigned char ftable_index(unsigned char in) {
   return ret;
 }
 
+// returns the value of a single hex digit, or -1 if it isnt one
+int hexval(unsigned char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
 // byte array <---> hex string conversions
 // NOTE: tried to make these as small and fast as possible for later reuse
 //       since i hadn't writen these *very useful* util functions in C before
@@ -166,25 +242,17 @@ UTIL_ERR hexstr_bytes(unsigned char* strbuff, unsigned char* bytebuff, unsigned
   // take the string 2 characters at a time to make a byte
   for (int i = 0; i < size*2; i+=2) {
     
-    // make a string for the byte
-    char a[2] = {strbuff[i], strbuff[i+1]};
-  
-    // TODO (Dragon): make sure this is how strtol actually works
-    // used to check errors after conversion
-    char* e = "";
-  
-    // TODO (Dragon): get rid of this library call altogether and just do some math
-    // make the final byte
-    unsigned char b = strtol(a, &e, 16);
+    // convert each character to its nibble value
+    int hi = hexval(strbuff[i]);
+    int lo = hexval(strbuff[i+1]);
     
-    // TODO (Dragon): make sure this is how strtol actually works
     // make sure the characters were valid
-    if (*e != '\0') {
+    if (hi < 0 || lo < 0) {
       return U_BAD_CHAR;
     }
     
     // copy it to the byte buffer
-    bytebuff[i/2] = b;
+    bytebuff[i/2] = (hi << 4) | lo;
   }
   
   return U_OK;
@@ -224,4 +292,62 @@ UTIL_ERR bytes_hexstr(unsigned char* bytebuff, unsigned char* strbuff, unsigned
   }
   
   return U_OK;
-}
\ No newline at end of file
+}
+
+// convert nblocks hex blocks at the start of buff to bytes in place
+UTIL_ERR hexblocks_decode(unsigned char* buff, uint64_t nblocks) {
+  UTIL_ERR e;
+  for (uint64_t i = 0; i < nblocks; i++) {
+    if ((e = hexstr_bytes(buff + i*2*BLOCK_SIZE, buff + i*BLOCK_SIZE, BLOCK_SIZE)) != U_OK) {
+      return e;
+    }
+  }
+  return U_OK;
+}
+
+// convert nblocks blocks of bytes at the start of buff to hex in place
+UTIL_ERR hexblocks_encode(unsigned char* buff, uint64_t nblocks) {
+  UTIL_ERR e;
+  for (uint64_t i = nblocks; i-- > 0;) {
+    // block i's hex starts at block 2i, so copy it out before writing over it
+    unsigned char block[BLOCK_SIZE];
+    memcpy(block, buff + i*BLOCK_SIZE, BLOCK_SIZE);
+    if ((e = bytes_hexstr(block, buff + i*2*BLOCK_SIZE, BLOCK_SIZE)) != U_OK) {
+      return e;
+    }
+  }
+  return U_OK;
+}
+
+
+// file helpers
+
+// read exactly len bytes at offset off of fd
+UTIL_ERR pread_full(int fd, unsigned char* buff, size_t len, off_t off) {
+  for (size_t done = 0; done < len;) {
+    ssize_t n = pread(fd, buff + done, len - done, off + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return U_BAD_IO;
+    }
+    done += n;
+  }
+  return U_OK;
+}
+
+// write exactly len bytes at offset off of fd
+UTIL_ERR pwrite_full(int fd, unsigned char* buff, size_t len, off_t off) {
+  for (size_t done = 0; done < len;) {
+    ssize_t n = pwrite(fd, buff + done, len - done, off + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return U_BAD_IO;
+    }
+    done += n;
+  }
+  return U_OK;
+}
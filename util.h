@@ -20,6 +20,10 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
 // globals
 // maximum argument string buffer size
 #define MAX_BUFF    512
@@ -37,6 +41,7 @@ typedef enum UTIL_ERR {
   U_BAD_BUFFER,
   U_BAD_SIZE,
   U_BAD_CHAR,
+  U_BAD_IO,
   U_UNKNOWN
 } UTIL_ERR;
 
@@ -58,9 +63,32 @@ void lrotate(unsigned char* array, unsigned int size, unsigned int shift);
 // return a 16bit short resulting from the concatenation of 2 bytes
 unsigned short catbytes(unsigned char b1, unsigned char b2);
 
+// pack 8 bytes into a 64bit word, first byte most significant
+// (same order the blocks are written in the hex strings)
+uint64_t bytes_u64(unsigned char* bytes);
+
+// unpack a 64bit word into 8 bytes, most significant first
+void u64_bytes(uint64_t in, unsigned char* bytes);
+
+// multiply by x in GF(2^64) mod x^64 + x^4 + x^3 + x + 1
+uint64_t gf64_dbl(uint64_t in);
+
+// divide by x in GF(2^64) mod x^64 + x^4 + x^3 + x + 1
+uint64_t gf64_half(uint64_t in);
+
+// splitmix64 finalizer, a well mixed 64bit value for every input
+// (counter based random numbers for the analysis tools)
+uint64_t mix64(uint64_t in);
+
+// unkeyed 64bit checksum of len bytes, for catching damage, not tampering
+uint64_t fingerprint64(unsigned char* data, size_t len);
+
 // format and return an index for the ftable
 unsigned char ftable_index(unsigned char in);
 
+// returns the value of a single hex digit, or -1 if it isnt one
+int hexval(unsigned char c);
+
 // buffer conversion
 // NOTE: size param represents the byte count for the *BYTE BUFFER*
 //       regardless of the conversion, use the number of raw bytes
@@ -72,4 +100,22 @@ UTIL_ERR hexstr_bytes(unsigned char* strbuff, unsigned char* bytebuff, unsigned
 // convert from a byte buffer of length size to a hex string buffer of length 2*size
 UTIL_ERR bytes_hexstr(unsigned char* bytebuff, unsigned char* strbuff, unsigned int size);
 
+// convert nblocks hex blocks at the start of buff to bytes in place
+// each block's bytes land before the hex they came from, so front to back is safe
+UTIL_ERR hexblocks_decode(unsigned char* buff, uint64_t nblocks);
+
+// convert nblocks blocks of bytes at the start of buff to hex in place
+// done back to front, since each block's hex overlaps the blocks after it
+UTIL_ERR hexblocks_encode(unsigned char* buff, uint64_t nblocks);
+
+
+// file helpers
+
+// read exactly len bytes at offset off of fd, retrying short and interrupted reads
+// U_BAD_IO on an error or end of file first
+UTIL_ERR pread_full(int fd, unsigned char* buff, size_t len, off_t off);
+
+// write exactly len bytes at offset off of fd, retrying short and interrupted writes
+UTIL_ERR pwrite_full(int fd, unsigned char* buff, size_t len, off_t off);
+
 #endif //_UTIL_H_
\ No newline at end of file
@@ -0,0 +1,243 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_analyze.c:
+//  implementation of the cryptanalysis toolkit declared in
+//  wsu_analyze.h
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_analyze.h"
+
+
+// the 256 one bit answers of parity(mask & f(x)) for x = 0..255, packed
+// 64 to a word so a whole row of the LAT is 4 popcounts
+typedef struct WC_PARITY {
+  uint64_t w[4];
+} WC_PARITY;
+
+static void wcParityVector(unsigned char mask, unsigned char* f, WC_PARITY* v) {
+  memset(v, 0, sizeof(WC_PARITY));
+  for (int x = 0; x < 256; x++) {
+    unsigned char y = f ? f[x] : x;
+    uint64_t bit = __builtin_parity(mask & y);
+    v->w[x / 64] |= bit << (x % 64);
+  }
+  return;
+}
+
+// difference distribution table
+void wcDDT(unsigned char* sbox, uint16_t ddt[256][256]) {
+  memset(ddt, 0, 256 * sizeof(ddt[0]));
+  for (int a = 0; a < 256; a++) {
+    for (int x = 0; x < 256; x++) {
+      ddt[a][sbox[x] ^ sbox[x ^ a]]++;
+    }
+  }
+  return;
+}
+
+// linear approximation table
+void wcLAT(unsigned char* sbox, int16_t lat[256][256]) {
+  static WC_PARITY in[256];
+  static WC_PARITY out[256];
+  
+  for (int m = 0; m < 256; m++) {
+    wcParityVector(m, NULL, &in[m]);
+    wcParityVector(m, sbox, &out[m]);
+  }
+  
+  // the approximation fails wherever the two parity vectors differ
+  for (int a = 0; a < 256; a++) {
+    for (int b = 0; b < 256; b++) {
+      int fails = 0;
+      for (int i = 0; i < 4; i++) {
+        fails += __builtin_popcountll(in[a].w[i] ^ out[b].w[i]);
+      }
+      lat[a][b] = 128 - fails;
+    }
+  }
+  
+  return;
+}
+
+// one line JSON summary of both tables
+void wcSboxReport(FILE* f, unsigned char* sbox) {
+  static uint16_t ddt[256][256];
+  static int16_t lat[256][256];
+  
+  wcDDT(sbox, ddt);
+  wcLAT(sbox, lat);
+  
+  // nonzero input differences/masks only, the zero row is trivial
+  int uniformity = 0;
+  int ua = 0;
+  int ub = 0;
+  int linearity = 0;
+  int la = 0;
+  int lb = 0;
+  int ddtzeros = 0;
+  for (int a = 1; a < 256; a++) {
+    for (int b = 0; b < 256; b++) {
+      if (ddt[a][b] > uniformity) {
+        uniformity = ddt[a][b];
+        ua = a;
+        ub = b;
+      }
+      ddtzeros += (ddt[a][b] == 0);
+      
+      int l = abs(lat[a][b]);
+      if (b > 0 && l > linearity) {
+        linearity = l;
+        la = a;
+        lb = b;
+      }
+    }
+  }
+  
+  // a permutation has an empty column 0 in every nonzero DDT row
+  int bijective = 1;
+  for (int a = 1; a < 256; a++) {
+    bijective &= (ddt[a][0] == 0);
+  }
+  
+  fprintf(f, "{\"sbox\":\"ftable\",\"bijective\":%s,\"differential_uniformity\":%d,"
+             "\"best_differential\":[%d,%d],\"max_diff_probability\":%.6f,\"ddt_zeros\":%d,"
+             "\"linearity\":%d,\"best_approximation\":[%d,%d],\"max_bias\":%.6f,\"nonlinearity\":%d}\n",
+          bijective ? "true" : "false", uniformity, ua, ub, uniformity / 256.0, ddtzeros,
+          linearity, la, lb, linearity / 256.0, 128 - linearity);
+  
+  return;
+}
+
+
+// arguments for trailChunk(), shared by every engine worker
+typedef struct WC_TRAIL_JOB {
+  WC_SCHED** scheds;      // one copy of the key per node
+  WC_TRAIL* trail;
+  uint64_t hits[WC_MAX_THREADS];
+} WC_TRAIL_JOB;
+
+// engine work function, samples [first, first+count)
+static WC_ERR wcTrailChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_TRAIL_JOB* job = arg;
+  WC_TRAIL* t = job->trail;
+  WC_SCHED* sched = job->scheds[wcEngineNode(thread)];
+  unsigned char a[WC_ANALYZE_BATCH * BLOCK_SIZE];
+  unsigned char b[WC_ANALYZE_BATCH * BLOCK_SIZE];
+  unsigned char ea[WC_ANALYZE_BATCH * BLOCK_SIZE];
+  unsigned char eb[WC_ANALYZE_BATCH * BLOCK_SIZE];
+  uint64_t hits = 0;
+  WC_ERR e;
+  
+  while (count > 0) {
+    uint64_t n = (count < WC_ANALYZE_BATCH) ? count : WC_ANALYZE_BATCH;
+    
+    for (uint64_t i = 0; i < n; i++) {
+      // counter based, so a sample is the same whichever thread draws it
+      uint64_t x = mix64(t->seed ^ mix64(first + i));
+      u64_bytes(x, a + i * BLOCK_SIZE);
+      if (t->kind == WC_TRAIL_DIFF) {
+        u64_bytes(x ^ t->in, b + i * BLOCK_SIZE);
+      }
+    }
+    
+    if ((e = wcCipherRounds(sched, t->rounds, a, ea, n)) != WC_OK) {
+      return e;
+    }
+    
+    if (t->kind == WC_TRAIL_DIFF) {
+      if ((e = wcCipherRounds(sched, t->rounds, b, eb, n)) != WC_OK) {
+        return e;
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        uint64_t d = bytes_u64(ea + i * BLOCK_SIZE) ^ bytes_u64(eb + i * BLOCK_SIZE);
+        hits += (d == t->out);
+      }
+    }
+    else {
+      // one bit per sample, 64 at a time, then count the whole word at once
+      for (uint64_t i = 0; i < n; i += 64) {
+        uint64_t fails = 0;
+        uint64_t m = (n - i < 64) ? n - i : 64;
+        for (uint64_t j = 0; j < m; j++) {
+          uint64_t x = bytes_u64(a + (i + j) * BLOCK_SIZE);
+          uint64_t y = bytes_u64(ea + (i + j) * BLOCK_SIZE);
+          fails |= (uint64_t)__builtin_parityll((x & t->in) ^ (y & t->out)) << j;
+        }
+        hits += m - __builtin_popcountll(fails);
+      }
+    }
+    
+    first += n;
+    count -= n;
+  }
+  
+  job->hits[thread] += hits;
+  
+  return WC_OK;
+}
+
+// run trail over the block engine with the given settings
+WC_ERR wcTrailSample(WC_SCHED* scheds[WC_MAX_NODES], WC_TRAIL* trail, unsigned int threads, uint64_t chunk) {
+  
+  if (scheds == NULL || trail == NULL) {
+    return WC_UNKNOWN;
+  }
+  if (trail->rounds < 1 || trail->rounds > NUM_ROUNDS) {
+    return WC_UNKNOWN;
+  }
+  
+  WC_TRAIL_JOB job;
+  memset(&job, 0, sizeof(job));
+  job.scheds = scheds;
+  job.trail = trail;
+  
+  WC_ERR e = wcEngineRun(threads, chunk, trail->samples, wcTrailChunk, &job);
+  
+  trail->hits = 0;
+  for (int i = 0; i < WC_MAX_THREADS; i++) {
+    trail->hits += job.hits[i];
+  }
+  
+  return e;
+}
+
+// one line JSON summary of a finished run
+void wcTrailReport(FILE* f, WC_TRAIL* trail) {
+  double p = trail->samples ? (double)trail->hits / trail->samples : 0.0;
+  
+  fprintf(f, "{\"kind\":\"%s\",\"rounds\":%u,\"in\":\"%016llX\",\"out\":\"%016llX\","
+             "\"samples\":%llu,\"hits\":%llu,",
+          trail->kind == WC_TRAIL_DIFF ? "diff" : "linear", trail->rounds,
+          (unsigned long long)trail->in, (unsigned long long)trail->out,
+          (unsigned long long)trail->samples, (unsigned long long)trail->hits);
+  
+  if (trail->kind == WC_TRAIL_DIFF) {
+    fprintf(f, "\"probability\":%.6e}\n", p);
+  }
+  else {
+    // whitening only flips the sign of the bias, so its size is what counts
+    fprintf(f, "\"probability\":%.6f,\"bias\":%.6e}\n", p, p - 0.5);
+  }
+  
+  return;
+}
@@ -0,0 +1,70 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_analyze.h:
+//  cryptanalysis toolkit interface. exact difference and
+//  linear tables for the F-Table, and sampled differential
+//  and linear probabilities through reduced round versions
+//  of the whole cipher
+
+
+// header guard
+#ifndef _WC_ANALYZE_H_
+#define _WC_ANALYZE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+#include "wsu_numa.h"
+
+// pairs (or inputs) generated and ciphered together in one kernel call
+#define WC_ANALYZE_BATCH 256
+
+// difference distribution table: ddt[a][b] = #{x : S(x) ^ S(x ^ a) = b}
+void wcDDT(unsigned char* sbox, uint16_t ddt[256][256]);
+
+// linear approximation table: lat[a][b] = #{x : a.x = b.S(x)} - 128
+void wcLAT(unsigned char* sbox, int16_t lat[256][256]);
+
+// one line JSON summary of both tables (uniformity, linearity, ...)
+void wcSboxReport(FILE* f, unsigned char* sbox);
+
+// what a sampling run measures
+typedef enum WC_TRAIL_KIND {
+  WC_TRAIL_DIFF,      // pairs x, x ^ in with E(x) ^ E(x ^ in) = out
+  WC_TRAIL_LINEAR     // inputs x with in.x = out.E(x)
+} WC_TRAIL_KIND;
+
+// a sampling run and its result
+typedef struct WC_TRAIL {
+  WC_TRAIL_KIND kind;
+  unsigned int rounds;    // 1 to NUM_ROUNDS
+  uint64_t in;            // input difference or mask
+  uint64_t out;           // output difference or mask
+  uint64_t samples;       // pairs or inputs to try
+  uint64_t seed;          // inputs are a function of seed and sample number only
+  uint64_t hits;          // filled in: samples that matched
+} WC_TRAIL;
+
+// run trail over the block engine with the given settings
+// scheds[n] is the key for the workers on engine node n, the same schedule
+// in every slot when the run isnt placed
+// results dont depend on the thread count or chunk size
+WC_ERR wcTrailSample(WC_SCHED* scheds[WC_MAX_NODES], WC_TRAIL* trail, unsigned int threads, uint64_t chunk);
+
+// one line JSON summary of a finished run
+void wcTrailReport(FILE* f, WC_TRAIL* trail);
+
+#endif //_WC_ANALYZE_H_
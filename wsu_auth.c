@@ -0,0 +1,223 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_auth.c:
+//  implementation of the authenticated mode declared in
+//  wsu_auth.h. the MAC follows PMAC1 (Black and Rogaway)
+//  with the offsets done in GF(2^64)
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_auth.h"
+
+
+// encrypt a single block held in a 64bit word
+static uint64_t wcAuthEncrypt(WC_SCHED* sched, uint64_t in) {
+  unsigned char b[BLOCK_SIZE];
+  u64_bytes(in, b);
+  wcCipherSched(sched, b, b, 'e');
+  return bytes_u64(b);
+}
+
+// a single MAC block
+static uint64_t wcAuthBlock(WC_AUTH* ctx, uint64_t in) {
+  return wcAuthEncrypt(&ctx->macsched, in);
+}
+
+// offset for MAC block p (p >= 1)
+// PMAC1 builds offsets by xoring in L(ntz(i)) for i = 1..p, which works out
+// to the xor of L(j) over the bits set in the gray code of p
+static uint64_t wcAuthOffset(WC_AUTH* ctx, uint64_t p) {
+  uint64_t gray = p ^ (p >> 1);
+  uint64_t off = 0;
+  for (int j = 0; gray; j++, gray >>= 1) {
+    if (gray & 1) {
+      off ^= ctx->ltab[j];
+    }
+  }
+  return off;
+}
+
+// set up ctx for a message of nblocks blocks under key and nonce
+WC_ERR wcAuthInit(WC_AUTH* ctx, unsigned char* key, unsigned char* nonce, uint64_t nblocks) {
+  
+  if (ctx == NULL || nonce == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  
+  // the callers key only ever enciphers the two derivation constants
+  WC_ERR e;
+  WC_SCHED master;
+  unsigned char sub[KEY_SIZE];
+  if ((e = wcSchedule(key, &master)) != WC_OK) {
+    return e;
+  }
+  u64_bytes(wcAuthEncrypt(&master, WC_AUTH_CTR_KEY), sub);
+  if ((e = wcSchedule(sub, &ctx->sched)) != WC_OK) {
+    return e;
+  }
+  u64_bytes(wcAuthEncrypt(&master, WC_AUTH_MAC_KEY), sub);
+  if ((e = wcSchedule(sub, &ctx->macsched)) != WC_OK) {
+    return e;
+  }
+  memset(&master, 0, sizeof(master));
+  memset(sub, 0, sizeof(sub));
+  
+  ctx->kernel = WC_KERN_SCHED;
+  ctx->nonce = bytes_u64(nonce);
+  ctx->nblocks = nblocks;
+  
+  // L = E(0) under the MAC subkey, then keep doubling it for the offset table
+  uint64_t l = wcAuthBlock(ctx, 0);
+  ctx->linv = gf64_half(l);
+  for (int j = 0; j < 64; j++) {
+    ctx->ltab[j] = l;
+    l = gf64_dbl(l);
+  }
+  
+  return WC_OK;
+}
+
+// build the keyed G tables of both subkeys
+WC_ERR wcAuthTables(WC_AUTH* ctx) {
+  WC_ERR e;
+  if ((e = wcScheduleTables(&ctx->sched)) != WC_OK) {
+    return e;
+  }
+  return wcScheduleTables(&ctx->macsched);
+}
+
+// release both subkey schedules
+void wcAuthFree(WC_AUTH* ctx) {
+  wcScheduleFree(&ctx->sched);
+  wcScheduleFree(&ctx->macsched);
+  return;
+}
+
+// encrypt ('e') or decrypt ('d') count blocks starting at message block first
+WC_ERR wcAuthChunk(WC_AUTH* ctx, unsigned char* inbuff, unsigned char* outbuff, uint64_t first, uint64_t count, char mode, uint64_t* sigma) {
+  
+  // make sure the buffers are good
+  if (inbuff == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  if (outbuff == NULL || sigma == NULL) {
+    return WC_BAD_DEST_BLOCK;
+  }
+  if (first + count > ctx->nblocks) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  
+  // MAC block number of the first block in this chunk, and its offset
+  uint64_t p = first + 2;
+  uint64_t last = ctx->nblocks + 1;
+  uint64_t off = wcAuthOffset(ctx, p);
+  uint64_t sum = 0;
+  WC_ERR e;
+  
+  unsigned char ks[WC_AUTH_BATCH * BLOCK_SIZE];   // keystream, then MAC outputs
+  unsigned char mac[WC_AUTH_BATCH * BLOCK_SIZE];  // MAC inputs
+  
+  for (uint64_t b = 0; b < count; b += WC_AUTH_BATCH) {
+    uint64_t n = count - b;
+    if (n > WC_AUTH_BATCH) {
+      n = WC_AUTH_BATCH;
+    }
+    unsigned char* in = inbuff + b * BLOCK_SIZE;
+    unsigned char* out = outbuff + b * BLOCK_SIZE;
+    
+    // CTR: keystream block i is E(nonce + block number)
+    for (uint64_t i = 0; i < n; i++) {
+      u64_bytes(ctx->nonce + first + b + i, ks + i * BLOCK_SIZE);
+    }
+    if ((e = wcCipherBlocks(ctx->kernel, &ctx->sched, ks, ks, n, 'e')) != WC_OK) {
+      return e;
+    }
+    
+    // xor in the keystream and set up the MAC inputs from the ciphertext
+    // while its still in cache
+    uint64_t nmac = 0;
+    for (uint64_t i = 0; i < n; i++, p++) {
+      uint64_t x = bytes_u64(in + i * BLOCK_SIZE);
+      uint64_t y = x ^ bytes_u64(ks + i * BLOCK_SIZE);
+      u64_bytes(y, out + i * BLOCK_SIZE);
+      
+      uint64_t c = (mode == 'e') ? y : x;
+      if (p == last) {
+        sum ^= c;
+      }
+      else {
+        u64_bytes(c ^ off, mac + nmac * BLOCK_SIZE);
+        nmac++;
+        off ^= ctx->ltab[__builtin_ctzll(p + 1)];
+      }
+    }
+    
+    // MAC: every block but the last goes through E(C ^ offset)
+    if ((e = wcCipherBlocks(ctx->kernel, &ctx->macsched, mac, mac, nmac, 'e')) != WC_OK) {
+      return e;
+    }
+    for (uint64_t i = 0; i < nmac; i++) {
+      sum ^= bytes_u64(mac + i * BLOCK_SIZE);
+    }
+  }
+  
+  *sigma ^= sum;
+  
+  return WC_OK;
+}
+
+// finish the MAC from the combined sigma of every chunk and write the tag
+WC_ERR wcAuthFinal(WC_AUTH* ctx, uint64_t sigma, unsigned char* tag) {
+  
+  if (tag == NULL) {
+    return WC_BAD_DEST_BLOCK;
+  }
+  
+  // the nonce is MAC block 1, and the last block unless theres no ciphertext
+  if (ctx->nblocks == 0) {
+    sigma ^= ctx->nonce;
+  }
+  else {
+    sigma ^= wcAuthBlock(ctx, ctx->nonce ^ wcAuthOffset(ctx, 1));
+  }
+  
+  u64_bytes(wcAuthBlock(ctx, sigma ^ ctx->linv), tag);
+  
+  return WC_OK;
+}
+
+// finish the MAC and compare it against tag in constant time
+WC_ERR wcAuthVerify(WC_AUTH* ctx, uint64_t sigma, unsigned char* tag) {
+  
+  if (tag == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  
+  unsigned char expect[BLOCK_SIZE];
+  wcAuthFinal(ctx, sigma, expect);
+  
+  unsigned char diff = 0;
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    diff |= expect[i] ^ tag[i];
+  }
+  
+  return diff ? WC_BAD_TAG : WC_OK;
+}
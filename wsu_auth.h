@@ -0,0 +1,84 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_auth.h:
+//  authenticated mode interface. CTR mode encryption with a
+//  PMAC style MAC over the nonce and ciphertext, both done
+//  in the same pass over each block
+
+
+// header guard
+#ifndef _WC_AUTH_H_
+#define _WC_AUTH_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// layout of an authenticated message:
+//  nonce (1 block) | ciphertext (n blocks) | tag (1 block)
+//
+// the keystream for block i is E(nonce + i). the MAC treats the nonce as
+// MAC block 1 and ciphertext block i as MAC block i+2, and every MAC block
+// but the last goes through E(M ^ offset). offsets only depend on the block
+// index, so any range of blocks can be done on its own and the partial
+// sums xored together in any order afterwards
+//
+// CTR and the MAC never run under the callers key itself. each gets its
+// own subkey, E_K(WC_AUTH_CTR_KEY) and E_K(WC_AUTH_MAC_KEY), so a keystream
+// block can never double as a MAC block output or L = E(0)
+//
+// NOTE: with a 64 bit block the counter and MAC both start losing security
+//       around 2^32 blocks (32GB) under one key. rekey well before that
+
+// blocks handled per kernel call inside a chunk. small enough that the
+// keystream, ciphertext and MAC inputs all stay in L1 between the passes
+#define WC_AUTH_BATCH 64
+
+// constants the CTR and MAC subkeys are derived from ("WSU-CTR!", "WSU-MAC!")
+#define WC_AUTH_CTR_KEY 0x5753552D43545221ULL
+#define WC_AUTH_MAC_KEY 0x5753552D4D414321ULL
+
+typedef struct WC_AUTH {
+  WC_SCHED sched;     // CTR subkey schedule
+  WC_SCHED macsched;  // MAC subkey schedule
+  WC_KERNEL kernel;   // bulk kernel, WC_KERN_SCHED unless the caller changes it
+  uint64_t nonce;     // starting counter, also the first MAC block
+  uint64_t nblocks;   // ciphertext blocks in the message
+  uint64_t ltab[64];  // L(j) = x^j * E(0) under the MAC subkey, offsets are xors of these
+  uint64_t linv;      // E(0) / x, masks the final MAC block
+} WC_AUTH;
+
+// set up ctx for a message of nblocks blocks under key and nonce
+// derives and schedules both subkeys, without their tables
+WC_ERR wcAuthInit(WC_AUTH* ctx, unsigned char* key, unsigned char* nonce, uint64_t nblocks);
+
+// build the keyed G tables of both subkeys, for WC_KERN_TABLE
+WC_ERR wcAuthTables(WC_AUTH* ctx);
+
+// release both subkey schedules
+void wcAuthFree(WC_AUTH* ctx);
+
+// encrypt ('e') or decrypt ('d') count blocks starting at message block first
+// inbuff and outbuff point at that first block, not the start of the message
+// the chunk's share of the MAC is xored into sigma
+WC_ERR wcAuthChunk(WC_AUTH* ctx, unsigned char* inbuff, unsigned char* outbuff, uint64_t first, uint64_t count, char mode, uint64_t* sigma);
+
+// finish the MAC from the combined sigma of every chunk and write the tag
+WC_ERR wcAuthFinal(WC_AUTH* ctx, uint64_t sigma, unsigned char* tag);
+
+// finish the MAC and compare it against tag in constant time
+WC_ERR wcAuthVerify(WC_AUTH* ctx, uint64_t sigma, unsigned char* tag);
+
+#endif //_WC_AUTH_H_
@@ -30,6 +30,9 @@
 #include "wsu_crypt.h"
 
 
+// the current stored key, rotated in place by wcK()
+unsigned char G_WC_KEY[KEY_SIZE];
+
 // returns a string representing an error code
 char* wcerr(WC_ERR errcode) {
   
@@ -45,6 +48,19 @@ char* wcerr(WC_ERR errcode) {
     break;
   case WC_BAD_DEST_BLOCK:
     estr = "BAD_DEST_BLOCK";
+    break;
+  case WC_BAD_TAG:
+    estr = "BAD_TAG";
+    break;
+  case WC_BAD_ALLOC:
+    estr = "BAD_ALLOC";
+    break;
+  case WC_BAD_THREAD:
+    estr = "BAD_THREAD";
+    break;
+  case WC_BAD_FILE:
+    estr = "BAD_FILE";
+    break;
   case WC_UNKNOWN: // intentionally fall through to default
   default:
     break;
@@ -62,9 +78,9 @@ WC_ERR wcF(unsigned short r0, unsigned short r1, unsigned int round, char mode,
   unsigned short t1;
   unsigned short _f0;
   unsigned short _f1;
-  unsigned char g1keys[4];
-  unsigned char g2keys[4];
-  unsigned char fkeys[4];
+  unsigned char g1keys[4] = {0};
+  unsigned char g2keys[4] = {0};
+  unsigned char fkeys[4] = {0};
   
   // values used for K() depending on mode
   unsigned int kround;
@@ -186,7 +202,7 @@ unsigned char wcK(unsigned char x, char mode) {
 // NOTE: this is written with a hard assumption that the key and block
 //       will be 64 bits in length, and variable lengths are not supported
 WC_ERR wcCipher(unsigned char* inbuff, unsigned char* outbuff, unsigned char* key, char mode) {
-    
+  
   // make sure the buffers are good
   if (inbuff == NULL) {
     return WC_BAD_SRC_BLOCK;
@@ -248,7 +264,7 @@ WC_ERR wcCipher(unsigned char* inbuff, unsigned char* outbuff, unsigned char* ke
   
   // perform each of the 16 rounds
   for (; round < NUM_ROUNDS; round++) {
-
+    
 #ifdef DEBUG_ROUNDS
     printf("[DBUG]: round %d rwords:\n r0: 0x%04X\n r1: 0x%04X\n r2: 0x%04X\n r3: 0x%04X\n", round, nextr[0], nextr[1], nextr[2], nextr[3]);
 #endif //DEBUG_ROUNDS
@@ -311,6 +327,460 @@ WC_ERR wcCipher(unsigned char* inbuff, unsigned char* outbuff, unsigned char* ke
   return WC_OK;
 }
 
+
+// precomputed key schedule
+
+// expand key into sched
+// replays the exact sequence of K() calls wcCipher() makes while encrypting
+// but on a local copy of the key. decryption walks the same subkeys backwards
+// (192 single bit rotations is a multiple of 64, so the key ends up back
+// where it started), so one table serves both modes
+WC_ERR wcSchedule(unsigned char* key, WC_SCHED* sched) {
+  
+  // make sure the buffers are good
+  if (key == NULL || sched == NULL) {
+    return WC_BAD_KEY;
+  }
+  
+  unsigned char k[KEY_SIZE];
+  memcpy(k, key, KEY_SIZE);
+  memcpy(sched->key, key, KEY_SIZE);
+  sched->tables = NULL;
+  sched->mapped = 0;
+  
+  // whitening uses the unrotated key
+  for (int i = 0; i < 4; i++) {
+    sched->kwords[i] = catbytes(k[2*i], k[2*i+1]);
+  }
+  
+  // each round asks for K(4r), K(4r+1), K(4r+2), K(4r+3) three times over
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    for (int i = 0; i < SUBKEYS_PER_ROUND; i++) {
+      lrotate(k, KEY_SIZE, 1);
+      sched->subkeys[round][i] = k[(4 * round + i % 4) % KEY_SIZE];
+    }
+  }
+  
+  return WC_OK;
+}
+
+// G() with the round's keys already picked out of the schedule
+static inline unsigned short wcGSched(unsigned short w, unsigned char* keys) {
+  unsigned char g1 = w >> 8;
+  unsigned char g2 = w & 0x00FF;
+  unsigned char g3 = FTABLE[g2 ^ keys[0]] ^ g1;
+  unsigned char g4 = FTABLE[g3 ^ keys[1]] ^ g2;
+  unsigned char g5 = FTABLE[g4 ^ keys[2]] ^ g3;
+  unsigned char g6 = FTABLE[g5 ^ keys[3]] ^ g4;
+  return catbytes(g5, g6);
+}
+
+// the round function rotates each R word as a 2 byte array in memory order
+// (see rrotate() and lrotate()). these do the same thing without the loops
+static inline unsigned short wcRotR(unsigned short w) {
+  unsigned char b[2];
+  memcpy(b, &w, 2);
+  unsigned char b0 = (b[0] >> 1) | ((b[1] & 1) << 7);
+  unsigned char b1 = (b[1] >> 1) | ((b[0] & 1) << 7);
+  b[0] = b0;
+  b[1] = b1;
+  memcpy(&w, b, 2);
+  return w;
+}
+
+static inline unsigned short wcRotL(unsigned short w) {
+  unsigned char b[2];
+  memcpy(b, &w, 2);
+  unsigned char b0 = (b[0] << 1) | (b[1] >> 7);
+  unsigned char b1 = (b[1] << 1) | (b[0] >> 7);
+  b[0] = b0;
+  b[1] = b1;
+  memcpy(&w, b, 2);
+  return w;
+}
+
+// same as wcCipher() but uses a precomputed schedule. reentrant
+// NOTE: no per round debug output here, this is the bulk path
+WC_ERR wcCipherSched(WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, char mode) {
+  
+  // make sure the buffers are good
+  if (inbuff == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  if (outbuff == NULL) {
+    return WC_BAD_DEST_BLOCK;
+  }
+  if (sched == NULL) {
+    return WC_BAD_KEY;
+  }
+  
+  // input whitening
+  unsigned short r[4] = {
+    catbytes(inbuff[0], inbuff[1]) ^ sched->kwords[0],
+    catbytes(inbuff[2], inbuff[3]) ^ sched->kwords[1],
+    catbytes(inbuff[4], inbuff[5]) ^ sched->kwords[2],
+    catbytes(inbuff[6], inbuff[7]) ^ sched->kwords[3]
+  };
+  
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    
+    // decryption uses the same subkeys in reverse round order
+    unsigned char* sk = sched->subkeys[(mode == 'e') ? round : NUM_ROUNDS - 1 - round];
+    
+    // F()
+    unsigned short t0 = wcGSched(r[0], sk);
+    unsigned short t1 = wcGSched(r[1], sk + 4);
+    unsigned short f0 = t0 + 2 * t1 + catbytes(sk[8], sk[9]);
+    unsigned short f1 = 2 * t0 + t1 + catbytes(sk[10], sk[11]);
+    
+    unsigned short n0;
+    unsigned short n1;
+    if (mode == 'e') {
+      n0 = wcRotR(r[2] ^ f0);
+      n1 = wcRotL(r[3]) ^ f1;
+    }
+    else {
+      n0 = wcRotL(r[2]) ^ f0;
+      n1 = wcRotR(r[3] ^ f1);
+    }
+    
+    r[2] = r[0];
+    r[3] = r[1];
+    r[0] = n0;
+    r[1] = n1;
+  }
+  
+  // undo the swap and output whitening
+  unsigned short y[4] = {
+    r[2] ^ sched->kwords[0],
+    r[3] ^ sched->kwords[1],
+    r[0] ^ sched->kwords[2],
+    r[1] ^ sched->kwords[3]
+  };
+  
+  for (int i = 0; i < 4; i++) {
+    outbuff[2*i] = y[i] >> 8;
+    outbuff[2*i+1] = y[i] & 0xFF;
+  }
+  
+  return WC_OK;
+}
+
+// block encrypted under the key for wcKeyCheck() ("WSU-IDX!", it started
+// out in the incremental index)
+#define WC_KEYCHECK_CONST 0x5753552D49445821ULL
+
+// value that changes with the key
+uint64_t wcKeyCheck(WC_SCHED* sched) {
+  unsigned char block[BLOCK_SIZE];
+  u64_bytes(WC_KEYCHECK_CONST, block);
+  wcCipherSched(sched, block, block, 'e');
+  return bytes_u64(block);
+}
+
+// build the keyed G tables for an expanded schedule
+WC_ERR wcScheduleTables(WC_SCHED* sched) {
+  
+  if (sched == NULL) {
+    return WC_BAD_KEY;
+  }
+  
+  // tables from a key store were built when the store was, and are read only
+  if (sched->mapped) {
+    return WC_OK;
+  }
+  
+  if (sched->tables == NULL) {
+    sched->tables = malloc(sizeof(WC_TABLES));
+    if (sched->tables == NULL) {
+      return WC_BAD_ALLOC;
+    }
+  }
+  
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    for (int i = 0; i < 8; i++) {
+      for (int x = 0; x < 256; x++) {
+        sched->tables->gtab[round][i][x] = FTABLE[x ^ sched->subkeys[round][i]];
+      }
+    }
+  }
+  
+  return WC_OK;
+}
+
+// release anything wcScheduleTables() allocated
+void wcScheduleFree(WC_SCHED* sched) {
+  if (sched != NULL) {
+    if (!sched->mapped) {
+      free(sched->tables);
+    }
+    sched->tables = NULL;
+    sched->mapped = 0;
+  }
+  return;
+}
+
+
+// bulk kernels
+
+// kernel names, in the order of WC_KERNEL
+static char* kernelnames[WC_NUM_KERNELS] = {
+  "ref", "sched", "table", "x4"
+};
+
+// returns the name of a kernel
+char* wcKernelName(WC_KERNEL kern) {
+  if (kern < 0 || kern >= WC_NUM_KERNELS) {
+    return "UNKNOWN";
+  }
+  return kernelnames[kern];
+}
+
+// returns the kernel called name, or WC_NUM_KERNELS if theres no such kernel
+WC_KERNEL wcKernelParse(char* name) {
+  for (int k = 0; k < WC_NUM_KERNELS; k++) {
+    if (strcmp(name, kernelnames[k]) == 0) {
+      return k;
+    }
+  }
+  return WC_NUM_KERNELS;
+}
+
+// G() through the keyed tables, t points at the round's 4 tables
+static inline unsigned short wcGTable(unsigned short w, unsigned char (*t)[256]) {
+  unsigned char g1 = w >> 8;
+  unsigned char g2 = w & 0x00FF;
+  unsigned char g3 = t[0][g2] ^ g1;
+  unsigned char g4 = t[1][g3] ^ g2;
+  unsigned char g5 = t[2][g4] ^ g3;
+  unsigned char g6 = t[3][g5] ^ g4;
+  return catbytes(g5, g6);
+}
+
+// one block through the keyed tables
+static void wcCipherTable(WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, char mode) {
+  
+  unsigned short r[4];
+  for (int i = 0; i < 4; i++) {
+    r[i] = catbytes(inbuff[2*i], inbuff[2*i+1]) ^ sched->kwords[i];
+  }
+  
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    int kround = (mode == 'e') ? round : NUM_ROUNDS - 1 - round;
+    unsigned char* sk = sched->subkeys[kround];
+    unsigned char (*t)[256] = sched->tables->gtab[kround];
+    
+    unsigned short t0 = wcGTable(r[0], t);
+    unsigned short t1 = wcGTable(r[1], t + 4);
+    unsigned short f0 = t0 + 2 * t1 + catbytes(sk[8], sk[9]);
+    unsigned short f1 = 2 * t0 + t1 + catbytes(sk[10], sk[11]);
+    
+    unsigned short n0 = (mode == 'e') ? wcRotR(r[2] ^ f0) : (wcRotL(r[2]) ^ f0);
+    unsigned short n1 = (mode == 'e') ? (wcRotL(r[3]) ^ f1) : wcRotR(r[3] ^ f1);
+    
+    r[2] = r[0];
+    r[3] = r[1];
+    r[0] = n0;
+    r[1] = n1;
+  }
+  
+  unsigned short y[4] = { r[2], r[3], r[0], r[1] };
+  for (int i = 0; i < 4; i++) {
+    y[i] ^= sched->kwords[i];
+    outbuff[2*i] = y[i] >> 8;
+    outbuff[2*i+1] = y[i] & 0xFF;
+  }
+  
+  return;
+}
+
+// WC_X4_LANES blocks at once, each round done for every block before moving
+// on so the table lookups from separate blocks can overlap in the pipeline
+#define WC_X4_LANES 4
+
+static void wcCipherX4(WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, char mode) {
+  
+  unsigned short r[WC_X4_LANES][4];
+  for (int l = 0; l < WC_X4_LANES; l++) {
+    unsigned char* in = inbuff + l * BLOCK_SIZE;
+    for (int i = 0; i < 4; i++) {
+      r[l][i] = catbytes(in[2*i], in[2*i+1]) ^ sched->kwords[i];
+    }
+  }
+  
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    unsigned char* sk = sched->subkeys[(mode == 'e') ? round : NUM_ROUNDS - 1 - round];
+    unsigned short k0 = catbytes(sk[8], sk[9]);
+    unsigned short k1 = catbytes(sk[10], sk[11]);
+    
+    for (int l = 0; l < WC_X4_LANES; l++) {
+      unsigned short t0 = wcGSched(r[l][0], sk);
+      unsigned short t1 = wcGSched(r[l][1], sk + 4);
+      unsigned short f0 = t0 + 2 * t1 + k0;
+      unsigned short f1 = 2 * t0 + t1 + k1;
+      
+      unsigned short n0 = (mode == 'e') ? wcRotR(r[l][2] ^ f0) : (wcRotL(r[l][2]) ^ f0);
+      unsigned short n1 = (mode == 'e') ? (wcRotL(r[l][3]) ^ f1) : wcRotR(r[l][3] ^ f1);
+      
+      r[l][2] = r[l][0];
+      r[l][3] = r[l][1];
+      r[l][0] = n0;
+      r[l][1] = n1;
+    }
+  }
+  
+  for (int l = 0; l < WC_X4_LANES; l++) {
+    unsigned char* out = outbuff + l * BLOCK_SIZE;
+    unsigned short y[4] = { r[l][2], r[l][3], r[l][0], r[l][1] };
+    for (int i = 0; i < 4; i++) {
+      y[i] ^= sched->kwords[i];
+      out[2*i] = y[i] >> 8;
+      out[2*i+1] = y[i] & 0xFF;
+    }
+  }
+  
+  return;
+}
+
+// encrypt/decrypt nblocks contiguous blocks with the given kernel
+WC_ERR wcCipherBlocks(WC_KERNEL kern, WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks, char mode) {
+  
+  // make sure the buffers are good
+  if (inbuff == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  if (outbuff == NULL) {
+    return WC_BAD_DEST_BLOCK;
+  }
+  if (sched == NULL) {
+    return WC_BAD_KEY;
+  }
+  
+  WC_ERR e = WC_OK;
+  uint64_t i = 0;
+  
+  switch (kern) {
+  case WC_KERN_REF:
+    for (; i < nblocks && e == WC_OK; i++) {
+      e = wcCipher(inbuff + i * BLOCK_SIZE, outbuff + i * BLOCK_SIZE, sched->key, mode);
+    }
+    break;
+  case WC_KERN_TABLE:
+    if (sched->tables == NULL) {
+      return WC_BAD_KEY;
+    }
+    for (; i < nblocks; i++) {
+      wcCipherTable(sched, inbuff + i * BLOCK_SIZE, outbuff + i * BLOCK_SIZE, mode);
+    }
+    break;
+  case WC_KERN_X4:
+    for (; i + WC_X4_LANES <= nblocks; i += WC_X4_LANES) {
+      wcCipherX4(sched, inbuff + i * BLOCK_SIZE, outbuff + i * BLOCK_SIZE, mode);
+    }
+    // intentionally fall through to finish the leftovers one at a time
+  case WC_KERN_SCHED:
+    for (; i < nblocks; i++) {
+      wcCipherSched(sched, inbuff + i * BLOCK_SIZE, outbuff + i * BLOCK_SIZE, mode);
+    }
+    break;
+  default:
+    return WC_UNKNOWN;
+  }
+  
+  return e;
+}
+
+
+// reduced round kernels
+
+// the first rounds rounds of encryption, whitening included, so with every
+// round it matches the full cipher. rounds is a constant in each kernel
+// below, which lets the compiler drop the loop bookkeeping entirely
+static inline void wcRounds(WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, const int rounds) {
+  
+  unsigned short r[4];
+  for (int i = 0; i < 4; i++) {
+    r[i] = catbytes(inbuff[2*i], inbuff[2*i+1]) ^ sched->kwords[i];
+  }
+  
+  for (int round = 0; round < rounds; round++) {
+    unsigned char* sk = sched->subkeys[round];
+    unsigned short t0 = wcGSched(r[0], sk);
+    unsigned short t1 = wcGSched(r[1], sk + 4);
+    unsigned short f0 = t0 + 2 * t1 + catbytes(sk[8], sk[9]);
+    unsigned short f1 = 2 * t0 + t1 + catbytes(sk[10], sk[11]);
+    
+    unsigned short n0 = wcRotR(r[2] ^ f0);
+    unsigned short n1 = wcRotL(r[3]) ^ f1;
+    
+    r[2] = r[0];
+    r[3] = r[1];
+    r[0] = n0;
+    r[1] = n1;
+  }
+  
+  unsigned short y[4] = { r[2], r[3], r[0], r[1] };
+  for (int i = 0; i < 4; i++) {
+    y[i] ^= sched->kwords[i];
+    outbuff[2*i] = y[i] >> 8;
+    outbuff[2*i+1] = y[i] & 0xFF;
+  }
+  
+  return;
+}
+
+// one kernel per round count
+#define WC_ROUNDS_KERNEL(n) \
+  static void wcRounds##n(WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks) { \
+    for (uint64_t i = 0; i < nblocks; i++) { \
+      wcRounds(sched, inbuff + i * BLOCK_SIZE, outbuff + i * BLOCK_SIZE, n); \
+    } \
+  }
+
+WC_ROUNDS_KERNEL(1)
+WC_ROUNDS_KERNEL(2)
+WC_ROUNDS_KERNEL(3)
+WC_ROUNDS_KERNEL(4)
+WC_ROUNDS_KERNEL(5)
+WC_ROUNDS_KERNEL(6)
+WC_ROUNDS_KERNEL(7)
+WC_ROUNDS_KERNEL(8)
+WC_ROUNDS_KERNEL(9)
+WC_ROUNDS_KERNEL(10)
+WC_ROUNDS_KERNEL(11)
+WC_ROUNDS_KERNEL(12)
+WC_ROUNDS_KERNEL(13)
+WC_ROUNDS_KERNEL(14)
+WC_ROUNDS_KERNEL(15)
+WC_ROUNDS_KERNEL(16)
+
+static void (*const G_WC_ROUNDS[NUM_ROUNDS + 1])(WC_SCHED*, unsigned char*, unsigned char*, uint64_t) = {
+  NULL,       wcRounds1,  wcRounds2,  wcRounds3,  wcRounds4,  wcRounds5,  wcRounds6,  wcRounds7,  wcRounds8,
+  wcRounds9,  wcRounds10, wcRounds11, wcRounds12, wcRounds13, wcRounds14, wcRounds15, wcRounds16
+};
+
+// encrypt nblocks contiguous blocks with only the first rounds rounds
+WC_ERR wcCipherRounds(WC_SCHED* sched, unsigned int rounds, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks) {
+  
+  // make sure the buffers are good
+  if (inbuff == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  if (outbuff == NULL) {
+    return WC_BAD_DEST_BLOCK;
+  }
+  if (sched == NULL) {
+    return WC_BAD_KEY;
+  }
+  if (rounds < 1 || rounds > NUM_ROUNDS) {
+    return WC_UNKNOWN;
+  }
+  
+  G_WC_ROUNDS[rounds](sched, inbuff, outbuff, nblocks);
+  
+  return WC_OK;
+}
+
 // at the bottom so we dont have to scroll past it all the time
 unsigned char FTABLE[] = {   // skipjack style F-Table
 0xa3,0xd7,0x09,0x83,0xf8,0x48,0xf6,0xf4,0xb3,0x21,0x15,0x78,0x99,0xb1,0xaf,0xf9,
@@ -30,6 +30,10 @@ typedef enum WC_ERR {
   WC_BAD_KEY,
   WC_BAD_SRC_BLOCK,
   WC_BAD_DEST_BLOCK,
+  WC_BAD_TAG,
+  WC_BAD_ALLOC,
+  WC_BAD_THREAD,
+  WC_BAD_FILE,
   WC_UNKNOWN
 } WC_ERR;
 
@@ -40,8 +44,9 @@ char* wcerr(WC_ERR errcode);  // returns a string representing an error code
 
 // globals
 // (i know this isnt safe but this is hw. never roll your own crypto in the wild)
-unsigned char G_WC_KEY[KEY_SIZE];      // the current stored key
-unsigned char FTABLE[16*16];  // skipjack style F-Table
+// defined in wsu_crypt.c, extern here so every includer shares one copy
+extern unsigned char G_WC_KEY[KEY_SIZE];      // the current stored key
+extern unsigned char FTABLE[16*16];  // skipjack style F-Table
 
 // cipher helper functions
 // puts F0 and F1 into fresults
@@ -56,4 +61,71 @@ unsigned char wcK(unsigned char x, char mode);
 // main operations copy between buffers internally and return error codes
 WC_ERR wcCipher(unsigned char* inbuff, unsigned char* outbuff, unsigned char* key, char mode);
 
+
+// precomputed key schedule
+// wcCipher() regenerates every subkey through wcK() on every block and
+// rotates G_WC_KEY while doing it, so it can only run on one block at a time.
+// the schedule holds the same subkeys computed once up front, which lets
+// any number of threads share a key without touching the globals
+
+// subkeys pulled from K() each round (4 for each G() and 4 for F())
+#define SUBKEYS_PER_ROUND 12
+
+// keyed G tables: FTABLE with each G() subkey xored in ahead of time,
+// gtab[round][i][x] = FTABLE[x ^ subkeys[round][i]] for the 8 G() subkeys
+typedef struct WC_TABLES {
+  unsigned char gtab[NUM_ROUNDS][8][256];
+} WC_TABLES;
+
+typedef struct WC_SCHED {
+  unsigned char subkeys[NUM_ROUNDS][SUBKEYS_PER_ROUND]; // g1, g2, f keys in encryption round order
+  unsigned short kwords[4];                             // key words for input/output whitening
+  unsigned char key[KEY_SIZE];                          // the raw key, for the reference kernel
+  WC_TABLES* tables;                                    // keyed G tables, NULL until built
+  unsigned char mapped;                                 // tables belong to a key store mapping, not freed here
+} WC_SCHED;
+
+// expand key into sched (without the tables)
+WC_ERR wcSchedule(unsigned char* key, WC_SCHED* sched);
+
+// build the keyed G tables for an expanded schedule
+WC_ERR wcScheduleTables(WC_SCHED* sched);
+
+// release anything wcScheduleTables() allocated (mapped tables are left alone)
+void wcScheduleFree(WC_SCHED* sched);
+
+// same as wcCipher() but uses a precomputed schedule. reentrant
+WC_ERR wcCipherSched(WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, char mode);
+
+// value that changes with the key without giving the key away, for files
+// that need to say which key they go with (indexes, manifests, key stores)
+uint64_t wcKeyCheck(WC_SCHED* sched);
+
+
+// bulk kernels
+// every kernel gives the same output, they only differ in speed, which
+// depends on the host. see wsu_tune.h for picking one automatically
+typedef enum WC_KERNEL {
+  WC_KERN_REF,      // wcCipher() a block at a time. uses the globals, one thread only
+  WC_KERN_SCHED,    // wcCipherSched() a block at a time
+  WC_KERN_TABLE,    // keyed G tables, needs wcScheduleTables()
+  WC_KERN_X4,       // schedule, 4 blocks interleaved round by round
+  WC_NUM_KERNELS
+} WC_KERNEL;
+
+// returns the name of a kernel
+char* wcKernelName(WC_KERNEL kern);
+
+// returns the kernel called name, or WC_NUM_KERNELS if theres no such kernel
+WC_KERNEL wcKernelParse(char* name);
+
+// encrypt/decrypt nblocks contiguous blocks with the given kernel
+// inbuff and outbuff may be the same buffer
+WC_ERR wcCipherBlocks(WC_KERNEL kern, WC_SCHED* sched, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks, char mode);
+
+// encrypt nblocks blocks with only the first rounds (1 to NUM_ROUNDS) rounds
+// of the cipher, for cryptanalysis. whitening is kept, so NUM_ROUNDS gives
+// the same output as the full cipher
+WC_ERR wcCipherRounds(WC_SCHED* sched, unsigned int rounds, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks);
+
 #endif //_WC_CRYPT_H_
@@ -0,0 +1,245 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_engine.c:
+//  implementation of the multithreaded block engine declared
+//  in wsu_engine.h. workers pull chunks off a shared counter
+//  until the run is used up, so a slow thread doesnt hold
+//  everybody else back. with a topology set the run is split
+//  into one region per node and workers only steal from
+//  another node once their own is used up
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_numa.h"
+#include "wsu_stats.h"
+
+
+// state shared by every worker in a run
+typedef struct WC_RUN {
+  pthread_mutex_t lock;   // guards next and err
+  int nregions;           // one per node in use, 1 without placement
+  uint64_t next[WC_MAX_NODES];  // first block of the next unclaimed chunk in each region
+  uint64_t end[WC_MAX_NODES];   // end of each region
+  uint64_t chunk;         // blocks per chunk
+  WC_CHUNK_FN fn;         // work function
+  void* arg;              // passed through to fn
+  WC_ERR err;             // first error reported by a chunk
+} WC_RUN;
+
+// what each worker thread gets handed
+typedef struct WC_WORKER {
+  WC_RUN* run;
+  unsigned int thread;
+  int node;
+} WC_WORKER;
+
+// placement set by wcEngineSetTopo(), NULL when off
+static WC_TOPO* G_WC_TOPO = NULL;
+
+
+// how many nodes a run actually spreads over
+static int wcEngineNodes(unsigned int threads) {
+  if (G_WC_TOPO == NULL) {
+    return 1;
+  }
+  return (threads < (unsigned int)G_WC_TOPO->nnodes) ? (int)threads : G_WC_TOPO->nnodes;
+}
+
+// spread workers over the nodes of topo, NULL turns it off
+void wcEngineSetTopo(WC_TOPO* topo) {
+  G_WC_TOPO = (topo != NULL && topo->nnodes > 0) ? topo : NULL;
+  return;
+}
+
+// node the engine puts worker thread on
+int wcEngineNode(unsigned int thread) {
+  return G_WC_TOPO ? wcTopoNode(G_WC_TOPO, thread) : 0;
+}
+
+// the blocks of a run that node's workers start on
+void wcEngineRegion(unsigned int threads, uint64_t chunk, uint64_t nblocks, int node, uint64_t* first, uint64_t* count) {
+  
+  // same clamping as wcEngineRun() so both agree on the split
+  if (chunk < 1) {
+    chunk = WC_DEFAULT_CHUNK;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  if (threads > WC_MAX_THREADS) {
+    threads = WC_MAX_THREADS;
+  }
+  uint64_t nchunks = (nblocks + chunk - 1) / chunk;
+  if (threads > nchunks) {
+    threads = nchunks ? nchunks : 1;
+  }
+  
+  // whole chunks per region so no chunk straddles two nodes
+  int nregions = wcEngineNodes(threads);
+  uint64_t per = (nchunks + nregions - 1) / nregions * chunk;
+  
+  *first = 0;
+  *count = 0;
+  if (node < 0 || node >= nregions) {
+    return;
+  }
+  *first = per * node;
+  if (*first > nblocks) {
+    *first = nblocks;
+  }
+  *count = (nblocks - *first < per) ? nblocks - *first : per;
+  
+  return;
+}
+
+
+// claim chunks until there are none left or somebody failed
+static void* wcWorker(void* p) {
+  WC_WORKER* w = p;
+  WC_RUN* run = w->run;
+  
+  if (G_WC_TOPO != NULL) {
+    wcNumaPin(G_WC_TOPO, w->node);
+  }
+  
+  for (;;) {
+    uint64_t first;
+    uint64_t count;
+    
+    // grab the next chunk, from our own node's region while it lasts
+    pthread_mutex_lock(&run->lock);
+    int r = w->node % run->nregions;
+    for (int i = 0; i < run->nregions && run->next[r] >= run->end[r]; i++) {
+      r = (r + 1) % run->nregions;
+    }
+    if (run->err != WC_OK || run->next[r] >= run->end[r]) {
+      pthread_mutex_unlock(&run->lock);
+      break;
+    }
+    first = run->next[r];
+    count = run->end[r] - first;
+    if (count > run->chunk) {
+      count = run->chunk;
+    }
+    run->next[r] += count;
+    pthread_mutex_unlock(&run->lock);
+    
+    // do the work outside the lock
+    uint64_t start = wcNow();
+    WC_ERR e = run->fn(run->arg, w->thread, first, count);
+    WC_STAT_ADD(w->thread, busyns, wcNow() - start);
+    WC_STAT_ADD(w->thread, chunks, 1);
+    
+    // keep the first error around for the caller
+    if (e != WC_OK) {
+      pthread_mutex_lock(&run->lock);
+      if (run->err == WC_OK) {
+        run->err = e;
+      }
+      pthread_mutex_unlock(&run->lock);
+      break;
+    }
+    
+    WC_STAT_ADD(w->thread, blocks, count);
+  }
+  
+  return NULL;
+}
+
+// run fn over nblocks blocks on up to threads workers, chunk blocks at a time
+WC_ERR wcEngineRun(unsigned int threads, uint64_t chunk, uint64_t nblocks, WC_CHUNK_FN fn, void* arg) {
+  
+  if (fn == NULL) {
+    return WC_UNKNOWN;
+  }
+  
+  // clamp the settings to something sane
+  if (chunk < 1) {
+    chunk = WC_DEFAULT_CHUNK;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  if (threads > WC_MAX_THREADS) {
+    threads = WC_MAX_THREADS;
+  }
+  
+  // no point starting threads that wont get a chunk
+  uint64_t nchunks = (nblocks + chunk - 1) / chunk;
+  if (threads > nchunks) {
+    threads = nchunks ? nchunks : 1;
+  }
+  
+  WC_RUN run;
+  pthread_mutex_init(&run.lock, NULL);
+  run.nregions = wcEngineNodes(threads);
+  for (int r = 0; r < run.nregions; r++) {
+    uint64_t count;
+    wcEngineRegion(threads, chunk, nblocks, r, &run.next[r], &count);
+    run.end[r] = run.next[r] + count;
+  }
+  run.chunk = chunk;
+  run.fn = fn;
+  run.arg = arg;
+  run.err = WC_OK;
+  
+  pthread_t tids[WC_MAX_THREADS];
+  WC_WORKER workers[WC_MAX_THREADS];
+  unsigned int started = 1;
+  
+  // start the extra workers, the caller is worker 0
+  for (unsigned int i = 1; i < threads; i++) {
+    workers[i].run = &run;
+    workers[i].thread = i;
+    workers[i].node = wcEngineNode(i);
+    if (pthread_create(&tids[i], NULL, wcWorker, &workers[i]) != 0) {
+      // let whatever did start finish the run
+      break;
+    }
+    started++;
+  }
+  
+#ifdef DEBUG
+  printf("[DBUG]: engine running %llu blocks on %u threads\n", (unsigned long long)nblocks, started);
+#endif //DEBUG
+  
+  // the caller works on node 0 for the run, then goes back to wherever
+  // it was allowed to run before, so pinning doesnt outlive the call
+  WC_AFFINITY aff;
+  aff.saved = 0;
+  if (G_WC_TOPO != NULL) {
+    wcNumaSave(&aff);
+  }
+  workers[0].run = &run;
+  workers[0].thread = 0;
+  workers[0].node = 0;
+  wcWorker(&workers[0]);
+  wcNumaRestore(&aff);
+  
+  for (unsigned int i = 1; i < started; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  
+  pthread_mutex_destroy(&run.lock);
+  
+  return run.err;
+}
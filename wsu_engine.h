@@ -0,0 +1,57 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_engine.h:
+//  multithreaded block engine interface. splits a run of
+//  blocks into chunks and hands them out to worker threads
+
+
+// header guard
+#ifndef _WC_ENGINE_H_
+#define _WC_ENGINE_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+#include "wsu_numa.h"
+
+// most worker threads the engine will start
+#define WC_MAX_THREADS    64
+
+// default number of blocks handed to a worker at a time
+#define WC_DEFAULT_CHUNK  4096
+
+// work function, called once for every chunk of blocks [first, first+count)
+// thread is the index of the worker running it (0 to threads-1), so callers
+// can keep per-thread results in an array and combine them afterwards
+// without any locking
+typedef WC_ERR (*WC_CHUNK_FN)(void* arg, unsigned int thread, uint64_t first, uint64_t count);
+
+// run fn over nblocks blocks on up to threads workers, chunk blocks at a time
+// the calling thread works as worker 0. returns the first error any chunk hit
+WC_ERR wcEngineRun(unsigned int threads, uint64_t chunk, uint64_t nblocks, WC_CHUNK_FN fn, void* arg);
+
+// spread workers over the nodes of topo, pinning each one to its node and
+// having it start on its own node's share of the blocks. NULL turns it off
+// the caller is only pinned to node 0 while it works, its mask is put back after
+void wcEngineSetTopo(WC_TOPO* topo);
+
+// node the engine puts worker thread on, 0 when placement is off
+int wcEngineNode(unsigned int thread);
+
+// the blocks [first, first+count) of a run that node's workers start on,
+// so callers can put that part of their buffers on the same node
+void wcEngineRegion(unsigned int threads, uint64_t chunk, uint64_t nblocks, int node, uint64_t* first, uint64_t* count);
+
+#endif //_WC_ENGINE_H_
@@ -0,0 +1,377 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_incr.c:
+//  implementation of the incremental re-encryption declared
+//  in wsu_incr.h. index files are the magic followed by the
+//  header fields and the fingerprints, all 64bit big endian
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_pool.h"
+#include "wsu_incr.h"
+
+
+// block encrypted under the key for the fingerprint key, which unlike the
+// key check is never written out
+#define WC_INDEX_PRINT_CONST 0x5753552D46504B21ULL // "WSU-FPK!"
+
+// header fields after the magic, the last one is the valid mark
+#define WC_INDEX_FIELDS 9
+#define WC_INDEX_VALID  0x56414C4944ULL             // "VALID"
+
+
+// empty index for nblocks blocks in chunks of chunkblocks
+WC_ERR wcIndexInit(WC_INDEX* idx, uint64_t chunkblocks, uint64_t keycheck, uint64_t nblocks, char mode) {
+  
+  if (idx == NULL || chunkblocks < 1) {
+    return WC_UNKNOWN;
+  }
+  
+  memset(idx, 0, sizeof(WC_INDEX));
+  idx->chunkblocks = chunkblocks;
+  idx->keycheck = keycheck;
+  idx->nblocks = nblocks;
+  idx->nchunks = (nblocks + chunkblocks - 1) / chunkblocks;
+  idx->mode = mode;
+  
+  // one spare so an empty file still gets a real allocation
+  if ((idx->prints = calloc(idx->nchunks + 1, sizeof(uint64_t))) == NULL) {
+    return WC_BAD_ALLOC;
+  }
+  
+  return WC_OK;
+}
+
+// read an index file
+WC_ERR wcIndexLoad(char* path, WC_INDEX* idx) {
+  
+  unsigned char buff[8 * WC_INDEX_FIELDS];
+  char magic[8];
+  WC_ERR e;
+  
+  memset(idx, 0, sizeof(WC_INDEX));
+  
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, WC_INDEX_MAGIC, 8) != 0 ||
+      fread(buff, 1, sizeof(buff), f) != sizeof(buff)) {
+    fclose(f);
+    return WC_BAD_FILE;
+  }
+  
+  uint64_t chunkblocks = bytes_u64(buff);
+  uint64_t keycheck = bytes_u64(buff + 8);
+  uint64_t nblocks = bytes_u64(buff + 16);
+  uint64_t nchunks = bytes_u64(buff + 24);
+  uint64_t mode = bytes_u64(buff + 32);
+  if (chunkblocks < 1 || nchunks != (nblocks + chunkblocks - 1) / chunkblocks || (mode != 'e' && mode != 'd') ||
+      bytes_u64(buff + 64) != WC_INDEX_VALID) {
+    fclose(f);
+    return WC_BAD_FILE;
+  }
+  
+  if ((e = wcIndexInit(idx, chunkblocks, keycheck, nblocks, mode)) != WC_OK) {
+    fclose(f);
+    return e;
+  }
+  idx->outsize = bytes_u64(buff + 40);
+  idx->outmtime = bytes_u64(buff + 48);
+  idx->outino = bytes_u64(buff + 56);
+  
+  for (uint64_t c = 0; c < nchunks; c++) {
+    unsigned char b[8];
+    if (fread(b, 1, 8, f) != 8) {
+      wcIndexFree(idx);
+      fclose(f);
+      return WC_BAD_FILE;
+    }
+    idx->prints[c] = bytes_u64(b);
+  }
+  
+  fclose(f);
+  
+  return WC_OK;
+}
+
+// write an index file
+WC_ERR wcIndexSave(char* path, WC_INDEX* idx) {
+  
+  char tmp[MAX_BUFF + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  
+  FILE* f = fopen(tmp, "wb");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  unsigned char buff[8 * WC_INDEX_FIELDS];
+  u64_bytes(idx->chunkblocks, buff);
+  u64_bytes(idx->keycheck, buff + 8);
+  u64_bytes(idx->nblocks, buff + 16);
+  u64_bytes(idx->nchunks, buff + 24);
+  u64_bytes(idx->mode, buff + 32);
+  u64_bytes(idx->outsize, buff + 40);
+  u64_bytes(idx->outmtime, buff + 48);
+  u64_bytes(idx->outino, buff + 56);
+  u64_bytes(WC_INDEX_VALID, buff + 64);
+  
+  int ok = fwrite(WC_INDEX_MAGIC, 1, 8, f) == 8 && fwrite(buff, 1, sizeof(buff), f) == sizeof(buff);
+  for (uint64_t c = 0; c < idx->nchunks && ok; c++) {
+    unsigned char b[8];
+    u64_bytes(idx->prints[c], b);
+    ok = fwrite(b, 1, 8, f) == 8;
+  }
+  
+  // on disk before the rename makes it the index
+  ok = (fflush(f) == 0) && ok;
+  ok = (fsync(fileno(f)) == 0) && ok;
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp, path) != 0) {
+    remove(tmp);
+    return WC_BAD_FILE;
+  }
+  
+  return WC_OK;
+}
+
+// mark the index file at path invalid on disk
+// only the valid mark is overwritten, and its synced before returning
+WC_ERR wcIndexInvalidate(char* path) {
+  
+  int fd = open(path, O_WRONLY);
+  if (fd < 0) {
+    return WC_OK;
+  }
+  
+  unsigned char mark[8] = {0};
+  int ok = pwrite_full(fd, mark, sizeof(mark), 8 + 8 * (WC_INDEX_FIELDS - 1)) == U_OK;
+  ok = (fsync(fd) == 0) && ok;
+  ok = (close(fd) == 0) && ok;
+  
+  return ok ? WC_OK : WC_BAD_FILE;
+}
+
+// release the fingerprints
+void wcIndexFree(WC_INDEX* idx) {
+  if (idx != NULL) {
+    free(idx->prints);
+    idx->prints = NULL;
+  }
+  return;
+}
+
+// what the output looks like from outside, see wcIndexStamp()
+static void outputIdentity(struct stat* st, uint64_t* size, uint64_t* mtime, uint64_t* ino) {
+  *size = st->st_size;
+  *mtime = (uint64_t)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec;
+  *ino = st->st_ino;
+  return;
+}
+
+// record the size, mtime and inode of the finished output
+WC_ERR wcIndexStamp(WC_INDEX* idx, int outfd) {
+  struct stat st;
+  if (fstat(outfd, &st) != 0) {
+    return WC_BAD_FILE;
+  }
+  outputIdentity(&st, &idx->outsize, &idx->outmtime, &idx->outino);
+  return WC_OK;
+}
+
+// is outfd still the output idx was stamped with
+int wcIndexMatches(WC_INDEX* idx, int outfd) {
+  struct stat st;
+  uint64_t size;
+  uint64_t mtime;
+  uint64_t ino;
+  if (fstat(outfd, &st) != 0) {
+    return 0;
+  }
+  outputIdentity(&st, &size, &mtime, &ino);
+  return size == idx->outsize && mtime == idx->outmtime && ino == idx->outino;
+}
+
+// forget the index of output outpath
+void wcIndexDrop(char* outpath) {
+  char idxpath[MAX_BUFF + 4];
+  snprintf(idxpath, sizeof(idxpath), "%s.idx", outpath);
+  remove(idxpath);
+  return;
+}
+
+// secret for wcIndexPrint()
+uint64_t wcIndexPrintKey(WC_SCHED* sched) {
+  unsigned char block[BLOCK_SIZE];
+  u64_bytes(WC_INDEX_PRINT_CONST, block);
+  wcCipherSched(sched, block, block, 'e');
+  return bytes_u64(block);
+}
+
+// keyed fingerprint of a chunk of input
+// the same splitmix64 chain as fingerprint64(), with the key in the seed,
+// added in at every step and folded in again at the end. its no MAC, but
+// a MAC would cost as much as the cipher the index is there to skip
+uint64_t wcIndexPrint(uint64_t printkey, unsigned char* data, size_t len) {
+  uint64_t h = mix64(printkey ^ len);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    h = mix64((h ^ bytes_u64(data + i)) + printkey);
+  }
+  if (i < len) {
+    unsigned char tail[8] = {0};
+    memcpy(tail, data + i, len - i);
+    h = mix64((h ^ bytes_u64(tail)) + printkey);
+  }
+  return mix64(h ^ printkey);
+}
+
+
+// arguments for incrChunk(), shared by every engine worker
+typedef struct WC_INCR_JOB {
+  WC_INCR* ctx;
+  int infd;
+  int outfd;
+  WC_INDEX* old;
+  WC_INDEX* cur;
+  uint64_t printkey;                      // wcIndexPrintKey() of the schedule
+  uint64_t changed[WC_MAX_THREADS];       // chunks each worker rewrote
+  unsigned char* buffs[WC_MAX_THREADS];   // each worker's scratch, if not pooled
+} WC_INCR_JOB;
+
+// engine work function. the engine chunk is the index chunk, so every
+// call is exactly one chunk of the index
+static WC_ERR incrChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_INCR_JOB* job = arg;
+  WC_INCR* ctx = job->ctx;
+  uint64_t c = first / job->cur->chunkblocks;
+  size_t len = count * 2*BLOCK_SIZE;
+  off_t off = (off_t)first * 2*BLOCK_SIZE;
+  unsigned char* buff = ctx->pool ? wcPoolGet(ctx->pool) : job->buffs[thread];
+  WC_SCHED* sched = ctx->scheds[wcEngineNode(thread)];
+  WC_ERR e = WC_OK;
+  
+  if (pread_full(job->infd, buff, len, off) != U_OK) {
+    e = WC_BAD_FILE;
+  }
+  
+  // unchanged since the output was last brought up to date
+  if (e == WC_OK) {
+    job->cur->prints[c] = wcIndexPrint(job->printkey, buff, len);
+    if (job->old != NULL && c < job->old->nchunks && job->old->prints[c] == job->cur->prints[c]) {
+      if (ctx->pool) {
+        wcPoolPut(ctx->pool, buff);
+      }
+      return WC_OK;
+    }
+  }
+  
+  // same steps as the streaming ECB path
+  if (e == WC_OK && hexblocks_decode(buff, count) != U_OK) {
+    e = WC_BAD_SRC_BLOCK;
+  }
+  if (e == WC_OK) {
+    e = wcCipherBlocks(ctx->kernel, sched ? sched : ctx->sched, buff, buff, count, ctx->mode);
+  }
+  if (e == WC_OK) {
+    hexblocks_encode(buff, count);
+  }
+  
+  if (e == WC_OK && pwrite_full(job->outfd, buff, len, off) != U_OK) {
+    e = WC_BAD_FILE;
+  }
+  
+  if (e == WC_OK) {
+    job->changed[thread]++;
+  }
+  
+  if (ctx->pool) {
+    wcPoolPut(ctx->pool, buff);
+  }
+  
+  return e;
+}
+
+// bring the hex output outfd up to date with the hex input infd
+WC_ERR wcIncrFile(WC_INCR* ctx, int infd, int outfd, WC_INDEX* old, WC_INDEX* cur, unsigned int threads, uint64_t* changed) {
+  
+  if (ctx == NULL || cur == NULL || infd < 0 || outfd < 0) {
+    return WC_BAD_FILE;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  if (threads > WC_MAX_THREADS) {
+    threads = WC_MAX_THREADS;
+  }
+  
+  // an index with other chunk boundaries is no help
+  if (old != NULL && old->chunkblocks != cur->chunkblocks) {
+    old = NULL;
+  }
+  
+  size_t bufflen = cur->chunkblocks * 2*BLOCK_SIZE;
+  if (ctx->pool != NULL && ctx->pool->size < bufflen) {
+    return WC_BAD_ALLOC;
+  }
+  
+  WC_INCR_JOB job;
+  memset(&job, 0, sizeof(job));
+  job.ctx = ctx;
+  job.infd = infd;
+  job.outfd = outfd;
+  job.old = old;
+  job.cur = cur;
+  job.printkey = wcIndexPrintKey(ctx->sched);
+  
+  // without a pool every worker gets its own scratch
+  WC_ERR e = WC_OK;
+  for (unsigned int t = 0; t < threads && e == WC_OK && ctx->pool == NULL; t++) {
+    if ((job.buffs[t] = malloc(bufflen)) == NULL) {
+      e = WC_BAD_ALLOC;
+    }
+  }
+  
+  if (e == WC_OK) {
+    e = wcEngineRun(threads, cur->chunkblocks, cur->nblocks, incrChunk, &job);
+  }
+  
+  for (unsigned int t = 0; t < threads; t++) {
+    free(job.buffs[t]);
+  }
+  
+  if (changed != NULL) {
+    *changed = 0;
+    for (int t = 0; t < WC_MAX_THREADS; t++) {
+      *changed += job.changed[t];
+    }
+  }
+  
+  return e;
+}
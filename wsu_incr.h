@@ -0,0 +1,102 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_incr.h:
+//  incremental re-encryption interface. keeps a sidecar index
+//  of per chunk input fingerprints next to the output and only
+//  runs the cipher on chunks whose input changed. ECB only,
+//  since every chunk there is independent of the rest
+
+
+// header guard
+#ifndef _WC_INCR_H_
+#define _WC_INCR_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+#include "wsu_numa.h"
+#include "wsu_pool.h"
+
+// first bytes of an index file
+#define WC_INDEX_MAGIC "WSUIDX03"
+
+// fingerprints of every chunk of an input file, and which output file
+// they describe. anything else writing the output changes its size, mtime
+// or inode, so the index stops matching it
+typedef struct WC_INDEX {
+  uint64_t chunkblocks;   // blocks per chunk
+  uint64_t keycheck;      // wcKeyCheck() of the key the output was made with
+  uint64_t nblocks;       // blocks in the input (and output)
+  uint64_t nchunks;       // chunks, the last may be partial
+  uint64_t mode;          // 'e' or 'd', which way the output was made
+  uint64_t outsize;       // output size in bytes when the index was written
+  uint64_t outmtime;      // output modification time, nanoseconds
+  uint64_t outino;        // output inode
+  uint64_t* prints;       // one keyed fingerprint per chunk, see wcIndexPrint()
+} WC_INDEX;
+
+// empty index for nblocks blocks in chunks of chunkblocks, made in mode
+WC_ERR wcIndexInit(WC_INDEX* idx, uint64_t chunkblocks, uint64_t keycheck, uint64_t nblocks, char mode);
+
+// read an index file. WC_BAD_FILE if its missing or doesnt look right
+WC_ERR wcIndexLoad(char* path, WC_INDEX* idx);
+
+// write an index file, through a temporary file and a rename so a crash
+// leaves either the old index or the new one. the new one is marked valid
+WC_ERR wcIndexSave(char* path, WC_INDEX* idx);
+
+// mark the index file at path invalid on disk, before its output gets
+// patched. wcIndexLoad() refuses it until wcIndexSave() replaces it, so a
+// crash part way through patching means a full run next time. fine if
+// theres no index
+WC_ERR wcIndexInvalidate(char* path);
+
+// release the fingerprints
+void wcIndexFree(WC_INDEX* idx);
+
+// record the size, mtime and inode of the finished output outfd
+WC_ERR wcIndexStamp(WC_INDEX* idx, int outfd);
+
+// nonzero if outfd is still exactly the output idx was stamped with
+int wcIndexMatches(WC_INDEX* idx, int outfd);
+
+// forget the index of output outpath, for anything that rewrites the output
+// without keeping the index up to date. fine if there isnt one
+void wcIndexDrop(char* outpath);
+
+// secret for wcIndexPrint(), derived from the key and never stored
+uint64_t wcIndexPrintKey(WC_SCHED* sched);
+
+// keyed fingerprint of a chunk of input, so someone without the key cant
+// work out a chunk's print, or pick a changed chunk that prints the same
+uint64_t wcIndexPrint(uint64_t printkey, unsigned char* data, size_t len);
+
+// settings for wcIncrFile()
+typedef struct WC_INCR {
+  WC_SCHED* sched;
+  WC_SCHED* scheds[WC_MAX_NODES];   // copy of sched on each node for the workers there, NULL to share sched
+  WC_KERNEL kernel;
+  char mode;              // 'e' or 'd'
+  WC_POOL* pool;          // scratch, buffers must hold chunkblocks hex blocks. NULL to malloc
+} WC_INCR;
+
+// bring the hex output outfd up to date with the hex input infd
+// every chunk of infd is fingerprinted into cur (already set up for the
+// input's size); chunks whose fingerprint matches old are left alone, the
+// rest are ciphered and written over the same place in outfd. old may be
+// NULL to redo everything. changed gets the number of chunks rewritten
+WC_ERR wcIncrFile(WC_INCR* ctx, int infd, int outfd, WC_INDEX* old, WC_INDEX* cur, unsigned int threads, uint64_t* changed);
+
+#endif //_WC_INCR_H_
@@ -0,0 +1,299 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_keystore.c:
+//  implementation of the key store declared in wsu_keystore.h.
+//  the file is the header, the directory, then each key's G
+//  tables on a page boundary. everything is in host byte order
+//  and the structs are used in place, so the header records
+//  enough about the build to refuse a store it cant read
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_keystore.h"
+
+
+// marker for the byte order check
+#define WC_KEYSTORE_ORDER 0x01020304
+
+// the header checksum covers everything before it
+#define WC_KEYHDR_SUMMED offsetof(WC_KEYHDR, hdrsum)
+
+// checksum of an entry: its id, tables checksum and schedule. cheap
+// enough to check on every use
+static uint64_t entrySum(WC_KEYENTRY* e) {
+  uint64_t h = fingerprint64((unsigned char*)e->id, WC_KEYID_MAX);
+  h = mix64(h ^ e->tabloff);
+  h = mix64(h ^ e->tabsum);
+  h = mix64(h ^ e->keycheck);
+  h = mix64(h ^ fingerprint64((unsigned char*)e->subkeys, sizeof(WC_KEYENTRY) - offsetof(WC_KEYENTRY, subkeys)));
+  return h;
+}
+
+// checksum of an entry's 32KB of tables, only checked by wcKeyStoreVerify()
+static uint64_t tableSum(unsigned char* base, WC_KEYENTRY* e) {
+  return e->tabloff ? fingerprint64(base + e->tabloff, sizeof(WC_TABLES)) : 0;
+}
+
+// qsort() order for the directory
+static int entryCmp(const void* a, const void* b) {
+  return strncmp(((const WC_KEYENTRY*)a)->id, ((const WC_KEYENTRY*)b)->id, WC_KEYID_MAX);
+}
+
+// write a store
+WC_ERR wcKeyStoreWrite(char* path, char** ids, unsigned char (*keys)[KEY_SIZE], int n, int tables) {
+  
+  if (n < 1 || n > WC_KEYSTORE_MAX) {
+    return WC_BAD_KEY;
+  }
+  for (int i = 0; i < n; i++) {
+    size_t len = strlen(ids[i]);
+    if (len == 0 || len >= WC_KEYID_MAX) {
+      return WC_BAD_KEY;
+    }
+  }
+  
+  // header and directory, then the tables page aligned after them
+  uint64_t dirend = sizeof(WC_KEYHDR) + (uint64_t)n * sizeof(WC_KEYENTRY);
+  uint64_t tabstart = (dirend + WC_KEYSTORE_ALIGN - 1) / WC_KEYSTORE_ALIGN * WC_KEYSTORE_ALIGN;
+  uint64_t tabstride = (sizeof(WC_TABLES) + WC_KEYSTORE_ALIGN - 1) / WC_KEYSTORE_ALIGN * WC_KEYSTORE_ALIGN;
+  uint64_t filesize = tables ? tabstart + n * tabstride : dirend;
+  
+  // built whole in memory, its only tens of KB a key
+  unsigned char* img = calloc(1, filesize);
+  if (img == NULL) {
+    return WC_BAD_ALLOC;
+  }
+  WC_KEYHDR* hdr = (WC_KEYHDR*)img;
+  WC_KEYENTRY* dir = (WC_KEYENTRY*)(img + sizeof(WC_KEYHDR));
+  
+  for (int i = 0; i < n; i++) {
+    WC_SCHED sched;
+    WC_ERR e;
+    if ((e = wcSchedule(keys[i], &sched)) != WC_OK) {
+      free(img);
+      return e;
+    }
+    strcpy(dir[i].id, ids[i]);
+    memcpy(dir[i].subkeys, sched.subkeys, sizeof(sched.subkeys));
+    memcpy(dir[i].kwords, sched.kwords, sizeof(sched.kwords));
+    memcpy(dir[i].key, sched.key, KEY_SIZE);
+    dir[i].keycheck = wcKeyCheck(&sched);
+  }
+  
+  // sorted so lookups can bisect, and a repeated id is easy to spot
+  qsort(dir, n, sizeof(WC_KEYENTRY), entryCmp);
+  for (int i = 1; i < n; i++) {
+    if (entryCmp(&dir[i-1], &dir[i]) == 0) {
+      free(img);
+      return WC_BAD_KEY;
+    }
+  }
+  
+  for (int i = 0; i < n; i++) {
+    if (tables) {
+      // build the tables right where the mapping will find them
+      WC_SCHED sched;
+      memcpy(sched.subkeys, dir[i].subkeys, sizeof(sched.subkeys));
+      sched.tables = (WC_TABLES*)(img + tabstart + i * tabstride);
+      sched.mapped = 0;
+      wcScheduleTables(&sched);
+      dir[i].tabloff = tabstart + i * tabstride;
+    }
+    dir[i].tabsum = tableSum(img, &dir[i]);
+    dir[i].sum = entrySum(&dir[i]);
+  }
+  
+  memcpy(hdr->magic, WC_KEYSTORE_MAGIC, 8);
+  hdr->version = WC_KEYSTORE_VERSION;
+  hdr->order = WC_KEYSTORE_ORDER;
+  hdr->count = n;
+  hdr->entrysize = sizeof(WC_KEYENTRY);
+  hdr->tablesize = sizeof(WC_TABLES);
+  hdr->filesize = filesize;
+  hdr->dirsum = fingerprint64((unsigned char*)dir, (size_t)n * sizeof(WC_KEYENTRY));
+  hdr->hdrsum = fingerprint64(img, WC_KEYHDR_SUMMED);
+  
+  char tmp[MAX_BUFF + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    free(img);
+    return WC_BAD_FILE;
+  }
+  
+  int ok = 1;
+  for (uint64_t done = 0; done < filesize && ok; ) {
+    ssize_t w = write(fd, img + done, filesize - done);
+    ok = w > 0;
+    done += ok ? w : 0;
+  }
+  free(img);
+  
+  // on disk before the rename makes it the store, and read back whole
+  // once so the tables never need summing again
+  ok = (fsync(fd) == 0) && ok;
+  ok = (close(fd) == 0) && ok;
+  WC_KEYSTORE ks;
+  if (ok && wcKeyStoreOpen(tmp, &ks) == WC_OK) {
+    ok = wcKeyStoreVerify(&ks, NULL) == WC_OK;
+    wcKeyStoreClose(&ks);
+  }
+  else {
+    ok = 0;
+  }
+  if (!ok || rename(tmp, path) != 0) {
+    remove(tmp);
+    return WC_BAD_FILE;
+  }
+  
+  return WC_OK;
+}
+
+// map a store
+WC_ERR wcKeyStoreOpen(char* path, WC_KEYSTORE* ks) {
+  
+  struct stat st;
+  memset(ks, 0, sizeof(*ks));
+  
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return WC_BAD_FILE;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(WC_KEYHDR)) {
+    close(fd);
+    return WC_BAD_FILE;
+  }
+  
+  // the mapping keeps the file alive, the descriptor isnt needed after this
+  void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return WC_BAD_FILE;
+  }
+  ks->base = base;
+  ks->len = st.st_size;
+  ks->hdr = base;
+  ks->dir = (WC_KEYENTRY*)(ks->base + sizeof(WC_KEYHDR));
+  
+  // only the header and directory are checked here, so opening costs the
+  // same however many tables the store holds. schedules are checked as
+  // used, tables by wcKeyStoreVerify()
+  WC_KEYHDR* hdr = ks->hdr;
+  int ok = memcmp(hdr->magic, WC_KEYSTORE_MAGIC, 8) == 0 &&
+           hdr->hdrsum == fingerprint64(ks->base, WC_KEYHDR_SUMMED) &&
+           hdr->version == WC_KEYSTORE_VERSION &&
+           hdr->order == WC_KEYSTORE_ORDER &&
+           hdr->entrysize == sizeof(WC_KEYENTRY) &&
+           hdr->tablesize == sizeof(WC_TABLES) &&
+           hdr->filesize == ks->len &&
+           hdr->count <= WC_KEYSTORE_MAX &&
+           sizeof(WC_KEYHDR) + (uint64_t)hdr->count * sizeof(WC_KEYENTRY) <= ks->len;
+  ok = ok && hdr->dirsum == fingerprint64((unsigned char*)ks->dir, (size_t)hdr->count * sizeof(WC_KEYENTRY));
+  if (!ok) {
+#ifdef DEBUG
+    printf("[DBUG]: key store %s failed its header checks\n", path);
+#endif //DEBUG
+    wcKeyStoreClose(ks);
+    return WC_BAD_FILE;
+  }
+  
+  return WC_OK;
+}
+
+// unmap a store
+void wcKeyStoreClose(WC_KEYSTORE* ks) {
+  if (ks != NULL && ks->base != NULL) {
+    munmap(ks->base, ks->len);
+    memset(ks, 0, sizeof(*ks));
+  }
+  return;
+}
+
+// entry for id
+WC_KEYENTRY* wcKeyStoreFind(WC_KEYSTORE* ks, char* id) {
+  WC_KEYENTRY key;
+  if (strlen(id) >= WC_KEYID_MAX) {
+    return NULL;
+  }
+  memset(key.id, 0, WC_KEYID_MAX);
+  strcpy(key.id, id);
+  return bsearch(&key, ks->dir, ks->hdr->count, sizeof(WC_KEYENTRY), entryCmp);
+}
+
+// fill sched from the entry for id
+WC_ERR wcKeyStoreGet(WC_KEYSTORE* ks, char* id, WC_SCHED* sched) {
+  
+  WC_KEYENTRY* e = wcKeyStoreFind(ks, id);
+  if (e == NULL) {
+    return WC_BAD_KEY;
+  }
+  
+  // tables have to be inside the file and where the writer puts them
+  if (e->tabloff && (e->tabloff % WC_KEYSTORE_ALIGN != 0 || e->tabloff + sizeof(WC_TABLES) > ks->len)) {
+    return WC_BAD_FILE;
+  }
+  if (entrySum(e) != e->sum) {
+    return WC_BAD_FILE;
+  }
+  
+  memcpy(sched->subkeys, e->subkeys, sizeof(sched->subkeys));
+  memcpy(sched->kwords, e->kwords, sizeof(sched->kwords));
+  memcpy(sched->key, e->key, KEY_SIZE);
+  sched->tables = e->tabloff ? (WC_TABLES*)(ks->base + e->tabloff) : NULL;
+  sched->mapped = (sched->tables != NULL);
+  
+  return WC_OK;
+}
+
+// check every entry, tables included
+WC_ERR wcKeyStoreVerify(WC_KEYSTORE* ks, uint32_t* bad) {
+  for (uint32_t i = 0; i < ks->hdr->count; i++) {
+    WC_KEYENTRY* e = &ks->dir[i];
+    int ok = entrySum(e) == e->sum;
+    ok = ok && (e->tabloff == 0 || (e->tabloff % WC_KEYSTORE_ALIGN == 0 && e->tabloff + sizeof(WC_TABLES) <= ks->len));
+    ok = ok && tableSum(ks->base, e) == e->tabsum;
+    if (!ok) {
+      if (bad != NULL) {
+        *bad = i;
+      }
+      return WC_BAD_FILE;
+    }
+  }
+  return WC_OK;
+}
+
+// print the directory
+void wcKeyStoreList(FILE* f, WC_KEYSTORE* ks) {
+  for (uint32_t i = 0; i < ks->hdr->count; i++) {
+    WC_KEYENTRY* e = &ks->dir[i];
+    fprintf(f, "%-*s keycheck=%016llX tables=%s\n", WC_KEYID_MAX - 1, e->id,
+            (unsigned long long)e->keycheck, e->tabloff ? "yes" : "no");
+  }
+  return;
+}
@@ -0,0 +1,111 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_keystore.h:
+//  key store interface. a key store file holds expanded key
+//  schedules (and optionally their keyed G tables) under key
+//  IDs, laid out so it can be mapped straight into memory and
+//  used without expanding anything at startup
+
+
+// header guard
+#ifndef _WC_KEYSTORE_H_
+#define _WC_KEYSTORE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// first bytes of a key store file
+#define WC_KEYSTORE_MAGIC "WSUKEYS\0"
+
+// layout version, bumped whenever the entries change shape
+#define WC_KEYSTORE_VERSION 2
+
+// longest key ID, counting the terminator
+#define WC_KEYID_MAX 48
+
+// most keys in one store
+#define WC_KEYSTORE_MAX 4096
+
+// tables are placed on boundaries of this many bytes in the file so
+// the mapping hands them out page aligned
+#define WC_KEYSTORE_ALIGN 4096
+
+// file header, at offset 0
+typedef struct WC_KEYHDR {
+  char magic[8];          // WC_KEYSTORE_MAGIC
+  uint32_t version;       // WC_KEYSTORE_VERSION
+  uint32_t order;         // 0x01020304 as written, catches a store from a host of the other byte order
+  uint32_t count;         // entries in the directory
+  uint32_t entrysize;     // sizeof(WC_KEYENTRY) when written
+  uint64_t tablesize;     // sizeof(WC_TABLES) when written
+  uint64_t filesize;      // bytes in the whole file
+  uint64_t dirsum;        // fingerprint64() of the directory
+  uint64_t hdrsum;        // fingerprint64() of everything above
+} WC_KEYHDR;
+
+// one key. the directory follows the header, sorted by id
+typedef struct WC_KEYENTRY {
+  char id[WC_KEYID_MAX];                                // NUL terminated
+  uint64_t tabloff;                                     // file offset of the keyed G tables, 0 if none
+  uint64_t sum;                                         // checksum of the id and schedule
+  uint64_t tabsum;                                      // checksum of the tables, 0 if none
+  uint64_t keycheck;                                    // wcKeyCheck() of the schedule
+  unsigned char subkeys[NUM_ROUNDS][SUBKEYS_PER_ROUND]; // same as WC_SCHED
+  unsigned short kwords[4];
+  unsigned char key[KEY_SIZE];
+} WC_KEYENTRY;
+
+// an open, mapped key store
+typedef struct WC_KEYSTORE {
+  unsigned char* base;    // start of the mapping
+  size_t len;             // bytes mapped
+  WC_KEYHDR* hdr;
+  WC_KEYENTRY* dir;       // hdr->count entries
+} WC_KEYSTORE;
+
+// write a store holding n keys under ids, with their G tables if tables
+// is nonzero. goes through a temporary file and a rename, and the file
+// is only readable by its owner since it holds the keys. the new file is
+// read back with wcKeyStoreVerify() before its renamed into place
+WC_ERR wcKeyStoreWrite(char* path, char** ids, unsigned char (*keys)[KEY_SIZE], int n, int tables);
+
+// map a store and check its header and directory. WC_BAD_FILE if its
+// missing, damaged, or was written by a different build
+WC_ERR wcKeyStoreOpen(char* path, WC_KEYSTORE* ks);
+
+// unmap a store. any schedules taken from it are no longer usable
+void wcKeyStoreClose(WC_KEYSTORE* ks);
+
+// entry for id, or NULL if the store doesnt have it
+WC_KEYENTRY* wcKeyStoreFind(WC_KEYSTORE* ks, char* id);
+
+// fill sched from the entry for id, after checking the checksum of its
+// schedule. the tables arent summed here, that would cost more than
+// building them; wcKeyStoreVerify() checks them. they stay in the mapping,
+// so sched is marked mapped and wcScheduleFree() wont release them.
+// WC_BAD_KEY if theres no such id, WC_BAD_FILE if the entry is damaged
+WC_ERR wcKeyStoreGet(WC_KEYSTORE* ks, char* id, WC_SCHED* sched);
+
+// check every entry of an open store, tables included. WC_BAD_FILE and
+// the index of the first bad entry in *bad (if not NULL) on a mismatch
+WC_ERR wcKeyStoreVerify(WC_KEYSTORE* ks, uint32_t* bad);
+
+// print the directory, one key per line
+void wcKeyStoreList(FILE* f, WC_KEYSTORE* ks);
+
+#endif //_WC_KEYSTORE_H_
@@ -0,0 +1,166 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_mbuf.c:
+//  implementation of the multi-buffer CBC scheduler declared
+//  in wsu_mbuf.h
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_mbuf.h"
+
+
+// set up a scheduler
+void wcMbInit(WC_MBUF* mb, WC_SCHED* sched, WC_KERNEL kernel, WC_MB_DONE_FN donefn, void* arg) {
+  memset(mb, 0, sizeof(WC_MBUF));
+  mb->sched = sched;
+  mb->kernel = kernel;
+  mb->donefn = donefn;
+  mb->arg = arg;
+  return;
+}
+
+// queue a stream. it gets a lane at the next step with a free one
+void wcMbSubmit(WC_MBUF* mb, WC_MB_STREAM* stream) {
+  stream->done = 0;
+  stream->next = NULL;
+  
+  if (mb->tail == NULL) {
+    mb->head = stream;
+  }
+  else {
+    mb->tail->next = stream;
+  }
+  mb->tail = stream;
+  
+  return;
+}
+
+// fill free lanes, then encrypt one block of every stream in a lane
+WC_ERR wcMbStep(WC_MBUF* mb, int* busy) {
+  
+  WC_ERR e;
+  unsigned char blocks[WC_MB_LANES * BLOCK_SIZE];
+  int lane[WC_MB_LANES];    // which lane each packed block came from
+  int n = 0;
+  
+  for (int l = 0; l < WC_MB_LANES; l++) {
+    
+    // hand free lanes to waiting streams, skipping (and finishing) empty ones
+    while (mb->lanes[l] == NULL && mb->head != NULL) {
+      WC_MB_STREAM* s = mb->head;
+      mb->head = s->next;
+      if (mb->head == NULL) {
+        mb->tail = NULL;
+      }
+      
+      if (s->nblocks == 0) {
+        if (mb->donefn != NULL) {
+          mb->donefn(s, mb->arg);
+        }
+        continue;
+      }
+      
+      mb->lanes[l] = s;
+      memcpy(mb->chain[l], s->iv, BLOCK_SIZE);
+    }
+    
+    if (mb->lanes[l] == NULL) {
+      continue;
+    }
+    
+    // gather P ^ previous ciphertext into the next packed slot
+    WC_MB_STREAM* s = mb->lanes[l];
+    unsigned char* p = s->inbuff + s->done * BLOCK_SIZE;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+      blocks[n * BLOCK_SIZE + i] = p[i] ^ mb->chain[l][i];
+    }
+    lane[n] = l;
+    n++;
+  }
+  
+  *busy = n;
+  if (n == 0) {
+    return WC_OK;
+  }
+  
+  // every active stream's next block in one go
+  if ((e = wcCipherBlocks(mb->kernel, mb->sched, blocks, blocks, n, 'e')) != WC_OK) {
+    return e;
+  }
+  mb->steps++;
+  mb->laneblocks += n;
+  
+  // scatter back out and retire anything that just finished
+  for (int i = 0; i < n; i++) {
+    int l = lane[i];
+    WC_MB_STREAM* s = mb->lanes[l];
+    
+    memcpy(s->outbuff + s->done * BLOCK_SIZE, blocks + i * BLOCK_SIZE, BLOCK_SIZE);
+    memcpy(mb->chain[l], blocks + i * BLOCK_SIZE, BLOCK_SIZE);
+    s->done++;
+    
+    if (s->done == s->nblocks) {
+      mb->lanes[l] = NULL;
+      if (mb->donefn != NULL) {
+        mb->donefn(s, mb->arg);
+      }
+    }
+  }
+  
+  return WC_OK;
+}
+
+// step until every submitted stream is finished
+WC_ERR wcMbFlush(WC_MBUF* mb) {
+  WC_ERR e;
+  int busy;
+  do {
+    if ((e = wcMbStep(mb, &busy)) != WC_OK) {
+      return e;
+    }
+  } while (busy > 0);
+  return WC_OK;
+}
+
+// CBC decryption as one bulk kernel call, then xor with the previous ciphertext
+WC_ERR wcCbcDecrypt(WC_KERNEL kernel, WC_SCHED* sched, unsigned char* iv, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks) {
+  
+  if (inbuff == NULL || iv == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  if (outbuff == NULL || outbuff == inbuff) {
+    return WC_BAD_DEST_BLOCK;
+  }
+  
+  WC_ERR e;
+  if ((e = wcCipherBlocks(kernel, sched, inbuff, outbuff, nblocks, 'd')) != WC_OK) {
+    return e;
+  }
+  
+  for (uint64_t b = 0; b < nblocks; b++) {
+    unsigned char* prev = b ? inbuff + (b - 1) * BLOCK_SIZE : iv;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+      outbuff[b * BLOCK_SIZE + i] ^= prev[i];
+    }
+  }
+  
+  return WC_OK;
+}
@@ -0,0 +1,84 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_mbuf.h:
+//  multi-buffer CBC interface. CBC encryption is serial inside
+//  a stream, so this interleaves blocks from several separate
+//  streams into one kernel call instead
+
+
+// header guard
+#ifndef _WC_MBUF_H_
+#define _WC_MBUF_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// streams encrypted side by side. a multiple of the x4 kernel's width
+#define WC_MB_LANES 8
+
+// one CBC stream. the caller owns the buffers and keeps them alive until
+// the done callback fires for it
+typedef struct WC_MB_STREAM {
+  unsigned char* inbuff;          // plaintext
+  unsigned char* outbuff;         // ciphertext, may be the same as inbuff
+  uint64_t nblocks;               // blocks in the stream
+  unsigned char iv[BLOCK_SIZE];   // initialization vector
+  void* user;                     // for the caller, untouched here
+  
+  // scheduler bookkeeping
+  uint64_t done;                  // blocks encrypted so far
+  struct WC_MB_STREAM* next;      // next stream waiting for a lane
+} WC_MB_STREAM;
+
+// called when a stream finishes and gives up its lane
+typedef void (*WC_MB_DONE_FN)(WC_MB_STREAM* stream, void* arg);
+
+// the scheduler
+typedef struct WC_MBUF {
+  WC_SCHED* sched;
+  WC_KERNEL kernel;
+  WC_MB_DONE_FN donefn;
+  void* arg;
+  
+  WC_MB_STREAM* lanes[WC_MB_LANES];             // stream in each lane, NULL if free
+  unsigned char chain[WC_MB_LANES][BLOCK_SIZE]; // each lane's previous ciphertext
+  WC_MB_STREAM* head;                           // streams waiting for a lane
+  WC_MB_STREAM* tail;
+  
+  // lane occupancy, so callers can see if theres enough streams in flight
+  uint64_t steps;                 // kernel calls made
+  uint64_t laneblocks;            // blocks encrypted across all of them
+} WC_MBUF;
+
+// set up a scheduler. donefn (may be NULL) is called with arg as each stream finishes
+void wcMbInit(WC_MBUF* mb, WC_SCHED* sched, WC_KERNEL kernel, WC_MB_DONE_FN donefn, void* arg);
+
+// queue a stream. it gets a lane at the next step with a free one
+void wcMbSubmit(WC_MBUF* mb, WC_MB_STREAM* stream);
+
+// fill free lanes, then encrypt one block of every stream in a lane with a
+// single kernel call. *busy is set to how many lanes were busy (0 once idle)
+// on a kernel error nothing is scattered back and the streams stay in their lanes
+WC_ERR wcMbStep(WC_MBUF* mb, int* busy);
+
+// step until every submitted stream is finished, or the kernel fails
+WC_ERR wcMbFlush(WC_MBUF* mb);
+
+// CBC decryption doesnt chain through the cipher, so it runs as one bulk
+// kernel call over the whole stream. inbuff and outbuff must not overlap
+WC_ERR wcCbcDecrypt(WC_KERNEL kernel, WC_SCHED* sched, unsigned char* iv, unsigned char* inbuff, unsigned char* outbuff, uint64_t nblocks);
+
+#endif //_WC_MBUF_H_
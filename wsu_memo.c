@@ -0,0 +1,213 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_memo.c:
+//  implementation of the ECB memo declared in wsu_memo.h.
+//  open addressing with a short linear probe, and a block that
+//  finds no room takes over its home slot, so the table keeps
+//  the recent blocks and never needs resizing
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_stats.h"
+#include "wsu_memo.h"
+
+
+// memo with room for at least entries blocks
+WC_ERR wcMemoInit(WC_MEMO* memo, uint64_t entries, unsigned int thread) {
+  
+  memset(memo, 0, sizeof(*memo));
+  
+  uint64_t slots = WC_MEMO_PROBES;
+  while (slots < entries && slots < WC_MEMO_MAX) {
+    slots <<= 1;
+  }
+  
+  memo->in = malloc(slots * sizeof(uint64_t));
+  memo->out = malloc(slots * sizeof(uint64_t));
+  memo->used = calloc(slots, 1);
+  if (memo->in == NULL || memo->out == NULL || memo->used == NULL) {
+    wcMemoFree(memo);
+    return WC_BAD_ALLOC;
+  }
+  memo->mask = slots - 1;
+  memo->thread = thread;
+  
+  return WC_OK;
+}
+
+// release the table
+void wcMemoFree(WC_MEMO* memo) {
+  if (memo != NULL) {
+    free(memo->in);
+    free(memo->out);
+    free(memo->used);
+    memo->in = NULL;
+    memo->out = NULL;
+    memo->used = NULL;
+  }
+  return;
+}
+
+// slot holding x, or -1
+static int64_t lookup(WC_MEMO* memo, uint64_t x) {
+  uint64_t h = mix64(x);
+  for (int k = 0; k < WC_MEMO_PROBES; k++) {
+    uint64_t s = (h + k) & memo->mask;
+    if (!memo->used[s]) {
+      return -1;
+    }
+    if (memo->in[s] == x) {
+      return s;
+    }
+  }
+  return -1;
+}
+
+// remember that x ciphers to y
+static void remember(WC_MEMO* memo, uint64_t x, uint64_t y) {
+  uint64_t h = mix64(x);
+  uint64_t s = h & memo->mask;
+  for (int k = 0; k < WC_MEMO_PROBES; k++) {
+    uint64_t t = (h + k) & memo->mask;
+    if (!memo->used[t] || memo->in[t] == x) {
+      s = t;
+      break;
+    }
+  }
+  memo->in[s] = x;
+  memo->out[s] = y;
+  memo->used[s] = 1;
+  return;
+}
+
+// is the block at p all zero
+static int isZero(unsigned char* p) {
+  uint64_t x;
+  memcpy(&x, p, BLOCK_SIZE);
+  return x == 0;
+}
+
+// cipher the n gathered misses and put each back where it came from
+static WC_ERR flush(WC_MEMO* memo, WC_KERNEL kern, WC_SCHED* sched, unsigned char* buff, char mode,
+                    unsigned char* gather, uint64_t* gin, uint64_t* where, unsigned int n) {
+  
+  WC_ERR e;
+  if (n == 0) {
+    return WC_OK;
+  }
+  if ((e = wcCipherBlocks(kern, sched, gather, gather, n, mode)) != WC_OK) {
+    return e;
+  }
+  
+  for (unsigned int k = 0; k < n; k++) {
+    uint64_t y;
+    memcpy(&y, gather + k*BLOCK_SIZE, BLOCK_SIZE);
+    memcpy(buff + where[k]*BLOCK_SIZE, &y, BLOCK_SIZE);
+    if (gin[k] == 0) {
+      memo->zero = y;
+      memo->haszero = 1;
+    }
+    else if (!memo->off) {
+      remember(memo, gin[k], y);
+    }
+  }
+  
+  return WC_OK;
+}
+
+// cipher nblocks blocks of buff in place through the memo
+WC_ERR wcMemoBlocks(WC_MEMO* memo, WC_KERNEL kern, WC_SCHED* sched, unsigned char* buff, uint64_t nblocks, char mode) {
+  
+  WC_ERR e;
+  unsigned char gather[WC_MEMO_GATHER * BLOCK_SIZE];
+  uint64_t gin[WC_MEMO_GATHER];     // input of each gathered block
+  uint64_t where[WC_MEMO_GATHER];   // and which block of buff it came from
+  unsigned int ng = 0;
+  uint64_t lookups = 0;
+  uint64_t hits = 0;
+  uint64_t zeros = 0;
+  uint64_t bypassed = 0;
+  
+  for (uint64_t i = 0; i < nblocks; i++) {
+    unsigned char* p = buff + i*BLOCK_SIZE;
+    uint64_t x;
+    memcpy(&x, p, BLOCK_SIZE);
+    
+    // zero pages come in long runs, take the whole run at once
+    if (x == 0 && memo->haszero) {
+      uint64_t end = i + 1;
+      while (end < nblocks && isZero(buff + end*BLOCK_SIZE)) {
+        end++;
+      }
+      for (uint64_t j = i; j < end; j++) {
+        memcpy(buff + j*BLOCK_SIZE, &memo->zero, BLOCK_SIZE);
+      }
+      zeros += end - i;
+      i = end - 1;
+      continue;
+    }
+    
+    if (x != 0 && !memo->off) {
+      lookups++;
+      int64_t s = lookup(memo, x);
+      if (s >= 0) {
+        memcpy(p, &memo->out[s], BLOCK_SIZE);
+        hits++;
+        continue;
+      }
+    }
+    else if (x != 0) {
+      bypassed++;
+    }
+    
+    gin[ng] = x;
+    where[ng] = i;
+    memcpy(gather + ng*BLOCK_SIZE, p, BLOCK_SIZE);
+    if (++ng == WC_MEMO_GATHER) {
+      if ((e = flush(memo, kern, sched, buff, mode, gather, gin, where, ng)) != WC_OK) {
+        return e;
+      }
+      ng = 0;
+    }
+  }
+  if ((e = flush(memo, kern, sched, buff, mode, gather, gin, where, ng)) != WC_OK) {
+    return e;
+  }
+  
+  // input that hardly ever repeats only pays for the lookups, so stop
+  // looking once the trial shows that. zero runs are still skipped
+  memo->lookups += lookups;
+  memo->hits += hits;
+  if (!memo->off && memo->lookups >= WC_MEMO_TRIAL && memo->hits * WC_MEMO_MIN_HIT < memo->lookups) {
+    memo->off = 1;
+#ifdef DEBUG
+    printf("[DBUG]: worker %u memo off after %llu hits in %llu lookups\n", memo->thread,
+           (unsigned long long)memo->hits, (unsigned long long)memo->lookups);
+#endif //DEBUG
+  }
+  
+  WC_STAT_ADD(memo->thread, memolookups, lookups);
+  WC_STAT_ADD(memo->thread, memohits, hits);
+  WC_STAT_ADD(memo->thread, memozeros, zeros);
+  WC_STAT_ADD(memo->thread, memobypassed, bypassed);
+  
+  return WC_OK;
+}
@@ -0,0 +1,72 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_memo.h:
+//  ECB memo interface. under one key the same input block
+//  always gives the same output block, so a worker can keep
+//  the blocks it has already ciphered in a small hash table
+//  and copy the answer instead of running all 16 rounds again
+
+
+// header guard
+#ifndef _WC_MEMO_H_
+#define _WC_MEMO_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// slots looked at for a block before its a miss
+#define WC_MEMO_PROBES  4
+
+// misses ciphered together, so the kernels still get runs of blocks
+#define WC_MEMO_GATHER  256
+
+// most slots in one memo
+#define WC_MEMO_MAX     (1ULL << 24)
+
+// lookups before a memo checks whether its earning its keep, and the
+// fraction of hits (1 in this many) it needs to keep going
+#define WC_MEMO_TRIAL   65536
+#define WC_MEMO_MIN_HIT 8
+
+// one worker's memo, for one key in one direction. blocks are kept as
+// their raw 8 bytes, never as numbers, so byte order doesnt matter
+typedef struct WC_MEMO {
+  uint64_t* in;           // input block for each slot
+  uint64_t* out;          // what it ciphers to
+  unsigned char* used;    // nonzero for slots holding a block
+  uint64_t mask;          // slots - 1, slots is a power of two
+  unsigned int thread;    // engine worker that owns it, for the statistics
+  int haszero;            // nonzero once zero is known
+  uint64_t zero;          // what the all zero block ciphers to
+  int off;                // gave up after a poor hit rate, only zeros are skipped now
+  uint64_t lookups;       // table lookups so far
+  uint64_t hits;          // and how many found the block
+} WC_MEMO;
+
+// memo with room for at least entries blocks (rounded up to a power of two)
+// owned by engine worker thread
+WC_ERR wcMemoInit(WC_MEMO* memo, uint64_t entries, unsigned int thread);
+
+// release the table
+void wcMemoFree(WC_MEMO* memo);
+
+// cipher nblocks blocks of buff in place, the same as wcCipherBlocks()
+// runs of zero blocks and blocks seen before are copied from the memo,
+// the rest go through the kernel together and are remembered
+// only the owning worker may call it, always with the same key and mode
+WC_ERR wcMemoBlocks(WC_MEMO* memo, WC_KERNEL kern, WC_SCHED* sched, unsigned char* buff, uint64_t nblocks, char mode);
+
+#endif //_WC_MEMO_H_
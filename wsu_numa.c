@@ -0,0 +1,266 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_numa.c:
+//  implementation of the NUMA placement declared in
+//  wsu_numa.h
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "wsu_crypt.h"
+#include "wsu_numa.h"
+
+
+// where the kernel lists the nodes
+#define WC_NODE_DIR "/sys/devices/system/node"
+
+
+// parse a kernel cpulist ("0-3,8,10-11") into cpus, returns how many
+static int wcParseCpuList(char* list, int* cpus, int max) {
+  int n = 0;
+  char* p = list;
+  
+  while (*p != '\0' && *p != '\n' && n < max) {
+    char* end;
+    long lo = strtol(p, &end, 10);
+    long hi = lo;
+    if (end == p) {
+      break;
+    }
+    if (*end == '-') {
+      p = end + 1;
+      hi = strtol(p, &end, 10);
+    }
+    for (long c = lo; c <= hi && n < max; c++) {
+      cpus[n++] = c;
+    }
+    p = (*end == ',') ? end + 1 : end;
+  }
+  
+  return n;
+}
+
+// find the nodes. falls back to one node with every online CPU
+WC_ERR wcTopoInit(WC_TOPO* topo) {
+  
+  if (topo == NULL) {
+    return WC_UNKNOWN;
+  }
+  memset(topo, 0, sizeof(WC_TOPO));
+  
+  // node numbers can have gaps, so just try every one in range
+  for (int id = 0; id < 64 && topo->nnodes < WC_MAX_NODES; id++) {
+    char path[MAX_BUFF];
+    char line[4096];
+    
+    snprintf(path, sizeof(path), WC_NODE_DIR "/node%d/cpulist", id);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+      continue;
+    }
+    if (fgets(line, sizeof(line), f) == NULL) {
+      line[0] = '\0';
+    }
+    fclose(f);
+    
+    int n = topo->nnodes;
+    topo->nodeid[n] = id;
+    topo->ncpus[n] = wcParseCpuList(line, topo->cpus[n], WC_MAX_NODE_CPUS);
+    
+    // "Node 0 MemTotal:       32768000 kB"
+    snprintf(path, sizeof(path), WC_NODE_DIR "/node%d/meminfo", id);
+    if ((f = fopen(path, "r")) != NULL) {
+      while (fgets(line, sizeof(line), f) != NULL) {
+        char* m = strstr(line, "MemTotal:");
+        if (m != NULL) {
+          topo->memkb[n] = strtoull(m + 9, NULL, 10);
+          break;
+        }
+      }
+      fclose(f);
+    }
+    
+    topo->nnodes++;
+  }
+  
+  if (topo->nnodes > 0) {
+    topo->numa = 1;
+    return WC_OK;
+  }
+  
+  // no NUMA info, treat the whole machine as node 0
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  topo->nnodes = 1;
+  topo->ncpus[0] = (ncpu < 1) ? 1 : (ncpu > WC_MAX_NODE_CPUS ? WC_MAX_NODE_CPUS : ncpu);
+  for (int c = 0; c < topo->ncpus[0]; c++) {
+    topo->cpus[0][c] = c;
+  }
+  
+  return WC_OK;
+}
+
+// print the topology in a human readable form
+void wcTopoReport(FILE* f, WC_TOPO* topo) {
+  
+  fprintf(f, "%d node%s%s\n", topo->nnodes, topo->nnodes == 1 ? "" : "s",
+          topo->numa ? "" : " (no NUMA information, using every online CPU)");
+  
+  for (int n = 0; n < topo->nnodes; n++) {
+    fprintf(f, "node %d: %d cpus, ", topo->nodeid[n], topo->ncpus[n]);
+    if (topo->memkb[n]) {
+      fprintf(f, "%llu MB", (unsigned long long)(topo->memkb[n] / 1024));
+    }
+    else {
+      fprintf(f, "memory unknown");
+    }
+    
+    // print the cpus back as ranges
+    fprintf(f, ", cpus ");
+    for (int i = 0; i < topo->ncpus[n]; i++) {
+      int lo = topo->cpus[n][i];
+      while (i + 1 < topo->ncpus[n] && topo->cpus[n][i+1] == topo->cpus[n][i] + 1) {
+        i++;
+      }
+      if (topo->cpus[n][i] == lo) {
+        fprintf(f, "%s%d", lo == topo->cpus[n][0] ? "" : ",", lo);
+      }
+      else {
+        fprintf(f, "%s%d-%d", lo == topo->cpus[n][0] ? "" : ",", lo, topo->cpus[n][i]);
+      }
+    }
+    fprintf(f, "\n");
+  }
+  
+  return;
+}
+
+// node an engine worker belongs on
+int wcTopoNode(WC_TOPO* topo, unsigned int thread) {
+  if (topo == NULL || topo->nnodes < 1) {
+    return 0;
+  }
+  return thread % topo->nnodes;
+}
+
+// pin the calling thread to the CPUs of node
+WC_ERR wcNumaPin(WC_TOPO* topo, int node) {
+  
+  if (topo == NULL || node < 0 || node >= topo->nnodes) {
+    return WC_BAD_THREAD;
+  }
+  
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int i = 0; i < topo->ncpus[node]; i++) {
+    CPU_SET(topo->cpus[node][i], &set);
+  }
+  
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    return WC_BAD_THREAD;
+  }
+  
+  return WC_OK;
+}
+
+// remember the calling thread's CPU mask
+WC_ERR wcNumaSave(WC_AFFINITY* aff) {
+  
+  aff->saved = 0;
+  if (sizeof(aff->mask) < sizeof(cpu_set_t) ||
+      sched_getaffinity(0, sizeof(cpu_set_t), (cpu_set_t*)aff->mask) != 0) {
+    return WC_BAD_THREAD;
+  }
+  aff->saved = 1;
+  
+  return WC_OK;
+}
+
+// put back a mask from wcNumaSave()
+WC_ERR wcNumaRestore(WC_AFFINITY* aff) {
+  
+  if (!aff->saved) {
+    return WC_OK;
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set_t), (cpu_set_t*)aff->mask) != 0) {
+    return WC_BAD_THREAD;
+  }
+  
+  return WC_OK;
+}
+
+// ask the kernel to put the pages of [addr, addr+len) on node
+WC_ERR wcNumaBind(WC_TOPO* topo, void* addr, size_t len, int node) {
+  
+  // nothing to do on a machine without nodes
+  if (topo == NULL || !topo->numa) {
+    return WC_OK;
+  }
+  if (node < 0 || node >= topo->nnodes) {
+    return WC_BAD_ALLOC;
+  }
+  
+  // mbind wants a page aligned start
+  long page = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(page - 1);
+  len += (uintptr_t)addr - start;
+  
+  // preferred rather than bound, so a full node spills over instead of failing
+  unsigned long mask = 1UL << topo->nodeid[node];
+  if (syscall(SYS_mbind, start, len, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0) != 0) {
+    return WC_BAD_ALLOC;
+  }
+  
+  return WC_OK;
+}
+
+// map len bytes on node, NULL on failure
+void* wcNumaAlloc(WC_TOPO* topo, size_t len, int node) {
+  void* p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  
+  // binding before anything touches the pages is what makes them land on node
+  wcNumaBind(topo, p, len, node);
+  
+  return p;
+}
+
+// node local copy of len bytes at src, NULL on failure
+void* wcNumaCopy(WC_TOPO* topo, void* src, size_t len, int node) {
+  void* p = wcNumaAlloc(topo, len, node);
+  if (p != NULL) {
+    memcpy(p, src, len);
+  }
+  return p;
+}
+
+// unmap something from wcNumaAlloc() or wcNumaCopy()
+void wcNumaRelease(void* p, size_t len) {
+  if (p != NULL) {
+    munmap(p, len);
+  }
+  return;
+}
@@ -0,0 +1,84 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_numa.h:
+//  NUMA placement interface. finds the memory nodes and their
+//  CPUs, pins threads to a node and puts memory on one. reads
+//  /sys and calls the kernel directly, so no libnuma needed
+
+
+// header guard
+#ifndef _WC_NUMA_H_
+#define _WC_NUMA_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// most nodes and CPUs per node tracked
+#define WC_MAX_NODES      16
+#define WC_MAX_NODE_CPUS  256
+
+// nodes are numbered 0 to nnodes-1 everywhere in here. nodeid[] maps
+// that back to the kernel's numbering, which can have gaps
+typedef struct WC_TOPO {
+  int nnodes;
+  int numa;                                     // nonzero if the kernel reported nodes
+  int nodeid[WC_MAX_NODES];                     // kernel node number
+  int ncpus[WC_MAX_NODES];                      // CPUs on each node
+  int cpus[WC_MAX_NODES][WC_MAX_NODE_CPUS];     // and which ones
+  uint64_t memkb[WC_MAX_NODES];                 // memory on each node, 0 if unknown
+} WC_TOPO;
+
+// a thread's CPU mask, kept so it can be put back after pinning
+// (same size as the kernel's cpu_set_t, 1024 CPUs)
+typedef struct WC_AFFINITY {
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+  int saved;                                    // nonzero if mask holds one
+} WC_AFFINITY;
+
+// find the nodes. falls back to one node with every online CPU
+WC_ERR wcTopoInit(WC_TOPO* topo);
+
+// print the topology in a human readable form
+void wcTopoReport(FILE* f, WC_TOPO* topo);
+
+// node an engine worker belongs on (workers are dealt out round robin)
+int wcTopoNode(WC_TOPO* topo, unsigned int thread);
+
+// pin the calling thread to the CPUs of node
+WC_ERR wcNumaPin(WC_TOPO* topo, int node);
+
+// remember the calling thread's CPU mask
+WC_ERR wcNumaSave(WC_AFFINITY* aff);
+
+// put back a mask from wcNumaSave(), if it got one
+WC_ERR wcNumaRestore(WC_AFFINITY* aff);
+
+// ask the kernel to put the pages of [addr, addr+len) on node when theyre
+// first touched. addr is rounded down to a page
+WC_ERR wcNumaBind(WC_TOPO* topo, void* addr, size_t len, int node);
+
+// map len bytes on node, NULL on failure
+void* wcNumaAlloc(WC_TOPO* topo, size_t len, int node);
+
+// node local copy of len bytes at src, NULL on failure
+void* wcNumaCopy(WC_TOPO* topo, void* src, size_t len, int node);
+
+// unmap something from wcNumaAlloc() or wcNumaCopy()
+void wcNumaRelease(void* p, size_t len);
+
+#endif //_WC_NUMA_H_
@@ -0,0 +1,326 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_pipe.c:
+//  implementation of the staged pipeline declared in wsu_pipe.h.
+//  the rings only use acquire/release loads and stores of the two
+//  indexes, a waiting end spins, then yields, then naps
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "wsu_crypt.h"
+#include "wsu_pool.h"
+#include "wsu_stats.h"
+#include "wsu_pipe.h"
+
+
+// bump one of a ring's or stage's counters. like WC_STAT_ADD(), only
+// one thread ever writes each of them and the reporter only reads
+#define WC_PIPE_ADD(field, n) \
+  __atomic_store_n(&(field), __atomic_load_n(&(field), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+// read a counter from any thread
+#define WC_PIPE_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+// spins before a waiting end starts yielding, and yields before it naps
+#define WC_PIPE_SPINS   64
+#define WC_PIPE_YIELDS  64
+#define WC_PIPE_NAP_NS  50000
+
+// arguments for a stage thread
+typedef struct WC_PIPE_WORKER {
+  WC_PIPE* pipe;
+  int stage;
+} WC_PIPE_WORKER;
+
+
+// wait a little longer every time round
+static void backoff(unsigned int* n) {
+  if (*n >= WC_PIPE_SPINS + WC_PIPE_YIELDS) {
+    struct timespec ts = {0, WC_PIPE_NAP_NS};
+    nanosleep(&ts, NULL);
+  }
+  else if (*n >= WC_PIPE_SPINS) {
+    sched_yield();
+  }
+  (*n)++;
+  return;
+}
+
+// stop every stage, keeping the first error
+static void fail(WC_PIPE* pipe, WC_ERR e) {
+  if (__atomic_exchange_n(&pipe->stop, 1, __ATOMIC_ACQ_REL) == 0) {
+    pipe->err = e;
+  }
+  return;
+}
+
+// queue an item, waiting for room. 0 if the pipeline stopped first
+static int ringPush(WC_RING* ring, WC_PIPE_ITEM* item) {
+  uint64_t tail = ring->tail;
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  
+  if (tail - head > ring->mask) {
+    uint64_t start = wcNow();
+    unsigned int n = 0;
+    while (tail - (head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) > ring->mask) {
+      if (__atomic_load_n(ring->stop, __ATOMIC_ACQUIRE)) {
+        return 0;
+      }
+      backoff(&n);
+    }
+    WC_PIPE_ADD(ring->fullwaits, 1);
+    WC_PIPE_ADD(ring->fullns, wcNow() - start);
+  }
+  
+  uint64_t queued = tail - head;
+  WC_PIPE_ADD(ring->occsum, queued);
+  if (queued + 1 > ring->peak) {
+    __atomic_store_n(&ring->peak, queued + 1, __ATOMIC_RELAXED);
+  }
+  
+  // the slot is written before the new tail lets the consumer see it
+  ring->slots[tail & ring->mask] = item;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  WC_PIPE_ADD(ring->pushes, 1);
+  
+  return 1;
+}
+
+// take the oldest item, waiting for one. NULL if the pipeline stopped first
+static WC_PIPE_ITEM* ringPop(WC_RING* ring) {
+  uint64_t head = ring->head;
+  
+  if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+    uint64_t start = wcNow();
+    unsigned int n = 0;
+    while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+      if (__atomic_load_n(ring->stop, __ATOMIC_ACQUIRE)) {
+        return NULL;
+      }
+      backoff(&n);
+    }
+    WC_PIPE_ADD(ring->emptywaits, 1);
+    WC_PIPE_ADD(ring->emptyns, wcNow() - start);
+  }
+  
+  // the slot is read before the new head hands it back to the producer
+  WC_PIPE_ITEM* item = ring->slots[head & ring->mask];
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  
+  return item;
+}
+
+// one stage: take an item from the ring in front, work on it, pass it on
+// the first stage ends the stream by passing on an empty item, and the
+// others leave once theyve passed it along (the last one just drops it)
+static void* stageThread(void* arg) {
+  WC_PIPE_WORKER* w = arg;
+  WC_PIPE* pipe = w->pipe;
+  WC_PIPE_STAGE* st = &pipe->stages[w->stage];
+  WC_RING* in = &pipe->rings[w->stage];
+  WC_RING* out = &pipe->rings[(w->stage + 1) % pipe->nstages];
+  int last = (w->stage == pipe->nstages - 1);
+  uint64_t seq = 0;
+  
+  for (;;) {
+    // nothing more gets done once any stage has failed, even if theres
+    // still work queued up
+    if (__atomic_load_n(&pipe->stop, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    WC_PIPE_ITEM* item = ringPop(in);
+    if (item == NULL) {
+      break;
+    }
+    
+    if (w->stage != 0 && item->nblocks == 0) {
+      if (!last) {
+        ringPush(out, item);
+      }
+      break;
+    }
+    
+    uint64_t start = wcNow();
+    WC_ERR e = st->fn(st->arg, item);
+    uint64_t ns = wcNow() - start;
+    WC_PIPE_ADD(st->busyns, ns);
+    WC_STAT_ADD_SHARED(0, stagens[st->stat], ns);
+    if (e != WC_OK) {
+      fail(pipe, e);
+      break;
+    }
+    
+    if (w->stage == 0) {
+      item->seq = seq++;
+      if (item->nblocks == 0) {
+        ringPush(out, item);
+        break;
+      }
+    }
+    WC_PIPE_ADD(st->items, 1);
+    
+    if (!ringPush(out, item)) {
+      break;
+    }
+  }
+  
+  return NULL;
+}
+
+// set up a pipeline with depth chunks
+WC_ERR wcPipeInit(WC_PIPE* pipe, WC_POOL* pool, unsigned int depth) {
+  
+  memset(pipe, 0, sizeof(*pipe));
+  if (depth < 1 || depth > WC_PIPE_MAX_DEPTH || pool == NULL || pool->count < depth) {
+    return WC_BAD_ALLOC;
+  }
+  
+  pipe->pool = pool;
+  pipe->depth = depth;
+  for (unsigned int i = 0; i < depth; i++) {
+    pipe->items[i].buff = wcPoolGet(pool);
+  }
+  
+  return WC_OK;
+}
+
+// add a stage
+WC_ERR wcPipeAddStage(WC_PIPE* pipe, WC_PIPE_FN fn, void* arg, WC_STAGE stat) {
+  
+  if (fn == NULL || pipe->nstages >= WC_PIPE_MAX_STAGES) {
+    return WC_UNKNOWN;
+  }
+  
+  // the free ring in front of the first stage holds every item, so the
+  // last stage never waits and the items cant jam. the rings between
+  // stages hold half as many, so a stage that gets ahead of the next one
+  // waits on a full ring (blocked) instead of taking every free item
+  uint64_t cap = 1;
+  if (pipe->nstages == 0) {
+    while (cap < pipe->depth) {
+      cap <<= 1;
+    }
+  }
+  else {
+    while (cap * 2 <= pipe->depth / 2) {
+      cap <<= 1;
+    }
+  }
+  
+  WC_RING* ring = &pipe->rings[pipe->nstages];
+  if ((ring->slots = calloc(cap, sizeof(WC_PIPE_ITEM*))) == NULL) {
+    return WC_BAD_ALLOC;
+  }
+  ring->mask = cap - 1;
+  ring->stop = &pipe->stop;
+  
+  WC_PIPE_STAGE* st = &pipe->stages[pipe->nstages++];
+  st->fn = fn;
+  st->arg = arg;
+  st->stat = stat;
+  
+  return WC_OK;
+}
+
+// run every stage on its own thread
+WC_ERR wcPipeRun(WC_PIPE* pipe) {
+  
+  if (pipe->nstages < 2) {
+    return WC_UNKNOWN;
+  }
+  
+  // every item starts out free, waiting for the first stage
+  for (unsigned int i = 0; i < pipe->depth; i++) {
+    ringPush(&pipe->rings[0], &pipe->items[i]);
+  }
+  
+  pthread_t tids[WC_PIPE_MAX_STAGES];
+  WC_PIPE_WORKER workers[WC_PIPE_MAX_STAGES];
+  int started = 1;
+  
+  // the caller runs the first stage
+  for (int s = 1; s < pipe->nstages; s++) {
+    workers[s].pipe = pipe;
+    workers[s].stage = s;
+    if (pthread_create(&tids[s], NULL, stageThread, &workers[s]) != 0) {
+      fail(pipe, WC_BAD_THREAD);
+      break;
+    }
+    started++;
+  }
+  
+#ifdef DEBUG
+  printf("[DBUG]: pipeline running %d stages, %u chunks deep\n", pipe->nstages, pipe->depth);
+#endif //DEBUG
+  
+  if (started == pipe->nstages) {
+    workers[0].pipe = pipe;
+    workers[0].stage = 0;
+    stageThread(&workers[0]);
+  }
+  
+  for (int s = 1; s < started; s++) {
+    pthread_join(tids[s], NULL);
+  }
+  
+  return pipe->stop ? pipe->err : WC_OK;
+}
+
+// give the buffers back
+// the counters are left alone so they can still be reported
+void wcPipeFree(WC_PIPE* pipe) {
+  for (unsigned int i = 0; i < pipe->depth; i++) {
+    wcPoolPut(pipe->pool, pipe->items[i].buff);
+  }
+  for (int s = 0; s < pipe->nstages; s++) {
+    free(pipe->rings[s].slots);
+    pipe->rings[s].slots = NULL;
+  }
+  return;
+}
+
+// print the counters
+// each stage is shown with the ring in front of it: how long it sat
+// starved waiting for work and how deep its queue ran. for the first
+// stage thats the free items, so its waits are the backpressure from
+// whichever stage is slowest
+void wcPipeReport(FILE* f, WC_PIPE* pipe) {
+  fprintf(f, "{\"depth\":%u,\"stages\":[", pipe->depth);
+  for (int s = 0; s < pipe->nstages; s++) {
+    WC_PIPE_STAGE* st = &pipe->stages[s];
+    WC_RING* in = &pipe->rings[s];
+    WC_RING* out = &pipe->rings[(s + 1) % pipe->nstages];
+    uint64_t pushes = WC_PIPE_GET(in->pushes);
+    fprintf(f, "%s{\"stage\":\"%s\",\"chunks\":%llu,\"busy_s\":%.6f,\"starved\":%llu,\"starved_s\":%.6f,"
+               "\"blocked\":%llu,\"blocked_s\":%.6f,\"avg_queue\":%.3f,\"peak_queue\":%llu}",
+            s ? "," : "", wcStageName(st->stat), (unsigned long long)WC_PIPE_GET(st->items),
+            WC_PIPE_GET(st->busyns) / 1e9,
+            (unsigned long long)WC_PIPE_GET(in->emptywaits), WC_PIPE_GET(in->emptyns) / 1e9,
+            (unsigned long long)WC_PIPE_GET(out->fullwaits), WC_PIPE_GET(out->fullns) / 1e9,
+            pushes ? (double)WC_PIPE_GET(in->occsum) / pushes : 0.0,
+            (unsigned long long)WC_PIPE_GET(in->peak));
+  }
+  fprintf(f, "]}");
+  return;
+}
@@ -0,0 +1,113 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_pipe.h:
+//  staged pipeline interface. every stage runs on its own
+//  thread and hands chunks to the next one through a bounded
+//  lock free single producer, single consumer ring, so reading,
+//  converting and ciphering different chunks overlap
+
+
+// header guard
+#ifndef _WC_PIPE_H_
+#define _WC_PIPE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+#include "wsu_pool.h"
+#include "wsu_stats.h"
+
+// most stages in one pipeline
+#define WC_PIPE_MAX_STAGES 8
+
+// most chunks in flight at once
+#define WC_PIPE_MAX_DEPTH 64
+
+// one chunk of the stream, passed from stage to stage
+typedef struct WC_PIPE_ITEM {
+  unsigned char* buff;    // pool buffer every stage works on in place
+  uint64_t nblocks;       // blocks in buff, 0 from the first stage ends the stream
+  uint64_t seq;           // chunks before this one
+} WC_PIPE_ITEM;
+
+// bounded ring of items with exactly one thread pushing and one popping
+// the two ends live on their own cache lines, each next to the counters
+// only that end writes, so neither side ever writes the other's line
+typedef struct WC_RING {
+  WC_PIPE_ITEM** slots;
+  uint64_t mask;          // capacity - 1, capacity is a power of two
+  int* stop;              // waits give up once this is set
+  
+  uint64_t tail __attribute__((aligned(64)));   // next slot to push, producer only
+  uint64_t pushes;        // items pushed
+  uint64_t fullwaits;     // pushes that found the ring full (backpressure), never on rings[0]
+  uint64_t fullns;        // time spent waiting for room
+  uint64_t occsum;        // items already queued, summed over every push
+  uint64_t peak;          // most items queued at once
+  
+  uint64_t head __attribute__((aligned(64)));   // next slot to pop, consumer only
+  uint64_t emptywaits;    // pops that found the ring empty (starved)
+  uint64_t emptyns;       // time spent waiting for an item
+} WC_RING;
+
+// what a stage does to each chunk. returning anything but WC_OK stops
+// the whole pipeline with that error
+typedef WC_ERR (*WC_PIPE_FN)(void* arg, WC_PIPE_ITEM* item);
+
+typedef struct WC_PIPE_STAGE {
+  WC_PIPE_FN fn;
+  void* arg;
+  WC_STAGE stat;          // driver stage its busy time is counted under
+  uint64_t items;         // chunks through this stage
+  uint64_t busyns;        // time spent in fn
+} WC_PIPE_STAGE;
+
+// the stages and the rings between them. rings[i] feeds stage i, and
+// rings[0] takes finished items from the last stage back to the first,
+// so depth items circulate. rings[0] can hold all of them, the others
+// about half, so a fast stage is held up about depth/2 chunks ahead of
+// a slow one
+typedef struct WC_PIPE {
+  WC_POOL* pool;
+  unsigned int depth;
+  WC_PIPE_ITEM items[WC_PIPE_MAX_DEPTH];
+  int nstages;
+  WC_PIPE_STAGE stages[WC_PIPE_MAX_STAGES];
+  WC_RING rings[WC_PIPE_MAX_STAGES];
+  int stop;               // set by the first stage to fail
+  WC_ERR err;             // and what it failed with
+} WC_PIPE;
+
+// set up a pipeline with depth chunks, each a buffer taken from pool
+// pool needs at least depth buffers
+WC_ERR wcPipeInit(WC_PIPE* pipe, WC_POOL* pool, unsigned int depth);
+
+// add a stage after the ones already added, with the ring in front of
+// it. the first stage fills each item (setting nblocks, 0 at the end),
+// the rest work on what it filled
+WC_ERR wcPipeAddStage(WC_PIPE* pipe, WC_PIPE_FN fn, void* arg, WC_STAGE stat);
+
+// run every stage on its own thread until the first one ends the stream
+// or any of them fails. returns the first error
+WC_ERR wcPipeRun(WC_PIPE* pipe);
+
+// give the buffers back to the pool. the counters can still be reported
+void wcPipeFree(WC_PIPE* pipe);
+
+// print the per stage and per ring counters as a JSON object
+void wcPipeReport(FILE* f, WC_PIPE* pipe);
+
+#endif //_WC_PIPE_H_
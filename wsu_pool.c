@@ -0,0 +1,199 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_pool.c:
+//  implementation of the buffer pool declared in wsu_pool.h.
+//  all the allocation happens in wcPoolInit(), after that the
+//  buffers just move between the free list and whoever has them
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "wsu_crypt.h"
+#include "wsu_pool.h"
+#include "wsu_stats.h"
+
+
+// huge page size assumed when rounding the mapping (x86-64 and arm64 default)
+#define WC_HUGE_PAGE (2 * 1024 * 1024)
+
+
+// map count buffers of size bytes
+WC_ERR wcPoolInit(WC_POOL* pool, size_t size, unsigned int count, int flags) {
+  
+  if (pool == NULL || size == 0 || count == 0) {
+    return WC_BAD_ALLOC;
+  }
+  
+  memset(pool, 0, sizeof(WC_POOL));
+  pool->size = size;
+  pool->stride = (size + WC_POOL_ALIGN - 1) & ~(size_t)(WC_POOL_ALIGN - 1);
+  pool->count = count;
+  pool->maplen = pool->stride * count;
+  pool->base = MAP_FAILED;
+  pool->pages = WC_PAGES_NORMAL;
+  
+  if (flags & WC_POOL_HUGE) {
+    // reserved huge pages first, theyre a sure thing if the admin set some aside
+    size_t hugelen = (pool->maplen + WC_HUGE_PAGE - 1) & ~(size_t)(WC_HUGE_PAGE - 1);
+#ifdef MAP_HUGETLB
+    pool->base = mmap(NULL, hugelen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pool->base != MAP_FAILED) {
+      pool->maplen = hugelen;
+      pool->pages = WC_PAGES_HUGETLB;
+    }
+#endif //MAP_HUGETLB
+    
+    // otherwise ask for transparent huge pages on a regular mapping
+    if (pool->base == MAP_FAILED) {
+      pool->maplen = hugelen;
+      pool->base = mmap(NULL, hugelen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+      if (pool->base != MAP_FAILED && madvise(pool->base, hugelen, MADV_HUGEPAGE) == 0) {
+        pool->pages = WC_PAGES_THP;
+      }
+#endif //MADV_HUGEPAGE
+    }
+  }
+  else {
+    pool->base = mmap(NULL, pool->maplen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  
+  if (pool->base == MAP_FAILED) {
+    pool->base = NULL;
+    return WC_BAD_ALLOC;
+  }
+  
+  pool->freelist = malloc(count * sizeof(unsigned char*));
+  if (pool->freelist == NULL) {
+    munmap(pool->base, pool->maplen);
+    pool->base = NULL;
+    return WC_BAD_ALLOC;
+  }
+  
+  // stack them so buffer 0 comes out first
+  for (unsigned int i = 0; i < count; i++) {
+    pool->freelist[i] = pool->base + (size_t)(count - 1 - i) * pool->stride;
+  }
+  pool->nfree = count;
+  
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+  
+#ifdef DEBUG
+  printf("[DBUG]: pool of %u x %zu bytes on %s pages\n", count, size, wcPoolPagesName(pool->pages));
+#endif //DEBUG
+  
+  return WC_OK;
+}
+
+// unmap the pool
+void wcPoolFree(WC_POOL* pool) {
+  if (pool == NULL || pool->base == NULL) {
+    return;
+  }
+  
+  munmap(pool->base, pool->maplen);
+  free(pool->freelist);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->cond);
+  pool->base = NULL;
+  
+  return;
+}
+
+// pop a free buffer, lock already held
+static unsigned char* wcPoolPop(WC_POOL* pool) {
+  unsigned char* buff = pool->freelist[--pool->nfree];
+  pool->gets++;
+  if (pool->count - pool->nfree > pool->peak) {
+    pool->peak = pool->count - pool->nfree;
+  }
+  return buff;
+}
+
+// take a buffer, waiting for one to come back if theyre all out
+unsigned char* wcPoolGet(WC_POOL* pool) {
+  pthread_mutex_lock(&pool->lock);
+  
+  if (pool->nfree == 0) {
+    uint64_t start = wcNow();
+    pool->waits++;
+    while (pool->nfree == 0) {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    pool->waitns += wcNow() - start;
+  }
+  
+  unsigned char* buff = wcPoolPop(pool);
+  pthread_mutex_unlock(&pool->lock);
+  
+  return buff;
+}
+
+// take a buffer if theres one free, NULL otherwise
+unsigned char* wcPoolTryGet(WC_POOL* pool) {
+  unsigned char* buff = NULL;
+  
+  pthread_mutex_lock(&pool->lock);
+  if (pool->nfree > 0) {
+    buff = wcPoolPop(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  
+  return buff;
+}
+
+// give a buffer back
+void wcPoolPut(WC_POOL* pool, unsigned char* buff) {
+  if (buff == NULL) {
+    return;
+  }
+  
+  pthread_mutex_lock(&pool->lock);
+  pool->freelist[pool->nfree++] = buff;
+  pthread_cond_signal(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+  
+  return;
+}
+
+// returns a string naming what backs the pool
+char* wcPoolPagesName(WC_POOL_PAGES pages) {
+  
+  char* pstr = "UNKNOWN";
+  
+  switch (pages) {
+  case WC_PAGES_NORMAL:
+    pstr = "normal";
+    break;
+  case WC_PAGES_HUGETLB:
+    pstr = "hugetlb";
+    break;
+  case WC_PAGES_THP:
+    pstr = "thp";
+    break;
+  default:
+    break;
+  }
+  
+  return pstr;
+}
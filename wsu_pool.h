@@ -0,0 +1,84 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_pool.h:
+//  buffer pool interface. a fixed set of equal sized, cache
+//  line aligned buffers carved out of one mapping and passed
+//  around instead of malloc'ing a new one for every batch
+
+
+// header guard
+#ifndef _WC_POOL_H_
+#define _WC_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "wsu_crypt.h"
+
+// every buffer starts on a cache line
+#define WC_POOL_ALIGN     64
+
+// flags for wcPoolInit()
+#define WC_POOL_HUGE      1   // back the pool with huge pages if at all possible
+
+// what ended up backing the pool
+typedef enum WC_POOL_PAGES {
+  WC_PAGES_NORMAL,    // regular pages
+  WC_PAGES_HUGETLB,   // MAP_HUGETLB, reserved huge pages
+  WC_PAGES_THP        // regular mapping with transparent huge pages requested
+} WC_POOL_PAGES;
+
+typedef struct WC_POOL {
+  unsigned char* base;      // the one mapping every buffer lives in
+  size_t maplen;            // its length
+  size_t size;              // bytes per buffer, as asked for
+  size_t stride;            // bytes between buffers, size rounded up to WC_POOL_ALIGN
+  unsigned int count;       // buffers in the pool
+  WC_POOL_PAGES pages;
+  
+  // free buffers, used as a stack so the most recently touched (and
+  // most likely still cached) buffer goes out first
+  unsigned char** freelist;
+  unsigned int nfree;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  
+  // pressure, guarded by lock
+  uint64_t gets;            // buffers handed out
+  uint64_t waits;           // times wcPoolGet() had to wait for one
+  uint64_t waitns;          // total time spent waiting
+  unsigned int peak;        // most buffers out at once
+} WC_POOL;
+
+// map count buffers of size bytes
+WC_ERR wcPoolInit(WC_POOL* pool, size_t size, unsigned int count, int flags);
+
+// unmap the pool. every buffer should be back by now
+void wcPoolFree(WC_POOL* pool);
+
+// take a buffer, waiting for one to come back if theyre all out
+unsigned char* wcPoolGet(WC_POOL* pool);
+
+// take a buffer if theres one free, NULL otherwise
+unsigned char* wcPoolTryGet(WC_POOL* pool);
+
+// give a buffer back
+void wcPoolPut(WC_POOL* pool, unsigned char* buff);
+
+// returns a string naming what backs the pool
+char* wcPoolPagesName(WC_POOL_PAGES pages);
+
+#endif //_WC_POOL_H_
@@ -0,0 +1,337 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_quality.c:
+//  implementation of the statistical quality harness declared
+//  in wsu_quality.h. flip counts go through bit sliced
+//  counters, so adding a 64 bit flip mask to 64 counters is
+//  a couple of word operations instead of 64 increments
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_stats.h"
+#include "wsu_quality.h"
+
+
+// bit sliced counters: bit k of plane p is bit p of counter k. 12 planes
+// count to 4095, enough for one batch (at most 64 adds per sample to a row)
+#define WC_VPLANES 12
+
+typedef struct WC_VCOUNT {
+  uint64_t plane[WC_VPLANES];
+} WC_VCOUNT;
+
+// add one to every counter whose bit is set in d
+static inline void wcVAdd(WC_VCOUNT* v, uint64_t d) {
+  for (int p = 0; p < WC_VPLANES && d; p++) {
+    uint64_t carry = v->plane[p] & d;
+    v->plane[p] ^= d;
+    d = carry;
+  }
+  return;
+}
+
+// move the sliced counts into counts[0..63] and clear them
+static void wcVFlush(WC_VCOUNT* v, uint64_t* counts) {
+  for (int p = 0; p < WC_VPLANES; p++) {
+    uint64_t w = v->plane[p];
+    while (w) {
+      counts[__builtin_ctzll(w)] += 1ULL << p;
+      w &= w - 1;
+    }
+    v->plane[p] = 0;
+  }
+  return;
+}
+
+// one worker's counts
+typedef struct WC_QACC {
+  WC_QUALITY q;
+  WC_VCOUNT sac[64];
+  WC_VCOUNT keysac[64];
+  WC_VCOUNT bic[64];
+} WC_QACC;
+
+// arguments for wcQualityChunk(), shared by every engine worker
+typedef struct WC_QUALITY_JOB {
+  WC_KERNEL kernel;
+  uint64_t seed;
+  WC_QACC* acc[WC_MAX_THREADS];   // allocated by each worker on first use
+} WC_QUALITY_JOB;
+
+
+// plaintext for sample s. mostly random, with counters and two bit
+// patterns mixed in so structured inputs get tested too
+static uint64_t wcQualityText(uint64_t seed, uint64_t s) {
+  uint64_t r = mix64(seed ^ mix64(s));
+  switch (s % 4) {
+  case 2:
+    return mix64(seed) + s;
+  case 3:
+    return (1ULL << (r % 64)) | (1ULL << ((r >> 6) % 64));
+  default:
+    return r;
+  }
+}
+
+// key for batch b, every other one low weight
+static uint64_t wcQualityKey(uint64_t seed, uint64_t b) {
+  uint64_t r = mix64(~seed ^ mix64(b));
+  return (b % 2) ? (1ULL << (r % 64)) : r;
+}
+
+// run n samples starting at first, all under the same key
+static WC_ERR wcQualityBatch(WC_QUALITY_JOB* job, unsigned int thread, uint64_t first, uint64_t n) {
+  
+  WC_QACC* acc = job->acc[thread];
+  unsigned char in[WC_QUALITY_BATCH * 65 * BLOCK_SIZE];
+  unsigned char out[WC_QUALITY_BATCH * 65 * BLOCK_SIZE];
+  unsigned char pts[WC_QUALITY_BATCH * BLOCK_SIZE];
+  unsigned char kout[WC_QUALITY_BATCH * BLOCK_SIZE];
+  uint64_t c0[WC_QUALITY_BATCH];
+  unsigned char key[KEY_SIZE];
+  WC_SCHED sched;
+  WC_ERR e;
+  
+  uint64_t k = wcQualityKey(job->seed, first / WC_QUALITY_BATCH);
+  u64_bytes(k, key);
+  wcSchedule(key, &sched);
+  if (job->kernel == WC_KERN_TABLE && (e = wcScheduleTables(&sched)) != WC_OK) {
+    return e;
+  }
+  
+  WC_STAT_ADD(thread, keysetups, 65);
+  
+  // each plaintext followed by its 64 one bit neighbours
+  for (uint64_t s = 0; s < n; s++) {
+    uint64_t x = wcQualityText(job->seed, first + s);
+    u64_bytes(x, pts + s * BLOCK_SIZE);
+    u64_bytes(x, in + s * 65 * BLOCK_SIZE);
+    for (int i = 0; i < 64; i++) {
+      u64_bytes(x ^ (1ULL << i), in + (s * 65 + 1 + i) * BLOCK_SIZE);
+    }
+  }
+  
+  e = wcCipherBlocks(job->kernel, &sched, in, out, n * 65, 'e');
+  wcScheduleFree(&sched);
+  if (e != WC_OK) {
+    return e;
+  }
+  
+  for (uint64_t s = 0; s < n; s++) {
+    unsigned char* c = out + s * 65 * BLOCK_SIZE;
+    c0[s] = bytes_u64(c);
+    
+    for (int b = 0; b < BLOCK_SIZE; b++) {
+      acc->q.bytes[c[b]]++;
+    }
+    for (uint64_t w = c0[s]; w; w &= w - 1) {
+      acc->q.ones[__builtin_ctzll(w)]++;
+    }
+    
+    for (int i = 0; i < 64; i++) {
+      uint64_t d = c0[s] ^ bytes_u64(c + (1 + i) * BLOCK_SIZE);
+      wcVAdd(&acc->sac[i], d);
+      acc->q.weight[__builtin_popcountll(d)]++;
+      for (uint64_t w = d; w; w &= w - 1) {
+        wcVAdd(&acc->bic[__builtin_ctzll(w)], d);
+      }
+    }
+  }
+  
+  // the same plaintexts under each one bit neighbour of the key. these
+  // schedules are thrown away straight after, so skip building tables
+  WC_KERNEL kk = (job->kernel == WC_KERN_TABLE) ? WC_KERN_X4 : job->kernel;
+  for (int i = 0; i < 64; i++) {
+    u64_bytes(k ^ (1ULL << i), key);
+    wcSchedule(key, &sched);
+    if ((e = wcCipherBlocks(kk, &sched, pts, kout, n, 'e')) != WC_OK) {
+      return e;
+    }
+    for (uint64_t s = 0; s < n; s++) {
+      wcVAdd(&acc->keysac[i], c0[s] ^ bytes_u64(kout + s * BLOCK_SIZE));
+    }
+  }
+  
+  for (int i = 0; i < 64; i++) {
+    wcVFlush(&acc->sac[i], acc->q.sac[i]);
+    wcVFlush(&acc->keysac[i], acc->q.keysac[i]);
+    wcVFlush(&acc->bic[i], acc->q.bic[i]);
+  }
+  acc->q.samples += n;
+  
+  return WC_OK;
+}
+
+// engine work function, samples [first, first+count)
+static WC_ERR wcQualityChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_QUALITY_JOB* job = arg;
+  WC_ERR e;
+  
+  // only this worker ever uses its slot
+  if (job->acc[thread] == NULL && (job->acc[thread] = calloc(1, sizeof(WC_QACC))) == NULL) {
+    return WC_BAD_ALLOC;
+  }
+  
+  // split on key boundaries so the keys dont depend on the chunk size
+  while (count > 0) {
+    uint64_t n = WC_QUALITY_BATCH - first % WC_QUALITY_BATCH;
+    if (n > count) {
+      n = count;
+    }
+    if ((e = wcQualityBatch(job, thread, first, n)) != WC_OK) {
+      return e;
+    }
+    first += n;
+    count -= n;
+  }
+  
+  return WC_OK;
+}
+
+// run the harness over samples plaintexts with kernel kern on the block engine
+WC_ERR wcQualityRun(WC_KERNEL kern, uint64_t samples, uint64_t seed, unsigned int threads, uint64_t chunk, WC_QUALITY* q) {
+  
+  if (q == NULL) {
+    return WC_UNKNOWN;
+  }
+  
+  WC_QUALITY_JOB job;
+  memset(&job, 0, sizeof(job));
+  job.kernel = kern;
+  job.seed = seed;
+  
+  WC_ERR e = wcEngineRun(threads, chunk, samples, wcQualityChunk, &job);
+  
+  // sum every worker's counts
+  memset(q, 0, sizeof(WC_QUALITY));
+  uint64_t* dst = (uint64_t*)q;
+  for (int t = 0; t < WC_MAX_THREADS; t++) {
+    if (job.acc[t] == NULL) {
+      continue;
+    }
+    uint64_t* src = (uint64_t*)&job.acc[t]->q;
+    for (size_t i = 0; i < sizeof(WC_QUALITY) / sizeof(uint64_t); i++) {
+      dst[i] += src[i];
+    }
+    free(job.acc[t]);
+  }
+  
+  return e;
+}
+
+// z score of count hits out of n trials with probability 1/2
+static double wcZHalf(uint64_t hits, uint64_t n) {
+  return n ? ((double)hits - n / 2.0) / sqrt(n / 4.0) : 0.0;
+}
+
+// the worst z score of a 64x64 flip table, with where it was
+static double wcWorstCell(uint64_t (*t)[64], uint64_t n, int* wi, int* wj) {
+  double worst = 0.0;
+  *wi = 0;
+  *wj = 0;
+  for (int i = 0; i < 64; i++) {
+    for (int j = 0; j < 64; j++) {
+      double z = fabs(wcZHalf(t[i][j], n));
+      if (z > worst) {
+        worst = z;
+        *wi = i;
+        *wj = j;
+      }
+    }
+  }
+  return worst;
+}
+
+// one line JSON report of a finished run
+int wcQualityReport(FILE* f, WC_QUALITY* q) {
+  
+  uint64_t n = q->samples;
+  uint64_t flips = n * 64;
+  int si;
+  int sj;
+  int ki;
+  int kj;
+  double sacz = wcWorstCell(q->sac, n, &si, &sj);
+  double keyz = wcWorstCell(q->keysac, n, &ki, &kj);
+  
+  // bit independence: correlation between two output bits flipping together
+  double bicr = 0.0;
+  int bj = 0;
+  int bk = 1;
+  for (int j = 0; j < 64 && flips; j++) {
+    for (int k = j + 1; k < 64; k++) {
+      double pj = (double)q->bic[j][j] / flips;
+      double pk = (double)q->bic[k][k] / flips;
+      double pjk = (double)q->bic[j][k] / flips;
+      double var = pj * (1 - pj) * pk * (1 - pk);
+      double r = (var > 0) ? (pjk - pj * pk) / sqrt(var) : 0.0;
+      if (fabs(r) > fabs(bicr)) {
+        bicr = r;
+        bj = j;
+        bk = k;
+      }
+    }
+  }
+  double bicz = fabs(bicr) * sqrt((double)flips);
+  
+  // flip weights should be binomial(64, 1/2), mean 32 and sd 4
+  double wsum = 0.0;
+  for (int w = 0; w <= 64; w++) {
+    wsum += (double)w * q->weight[w];
+  }
+  double wmean = flips ? wsum / flips : 0.0;
+  double weightz = flips ? fabs(wmean - 32.0) * sqrt((double)flips) / 4.0 : 0.0;
+  
+  // output balance per bit and over byte values
+  double onesz = 0.0;
+  for (int j = 0; j < 64; j++) {
+    double z = fabs(wcZHalf(q->ones[j], n));
+    onesz = (z > onesz) ? z : onesz;
+  }
+  double chi2 = 0.0;
+  double expect = n * BLOCK_SIZE / 256.0;
+  for (int b = 0; b < 256 && n; b++) {
+    chi2 += (q->bytes[b] - expect) * (q->bytes[b] - expect) / expect;
+  }
+  double bytesz = fabs(chi2 - 255.0) / sqrt(2.0 * 255.0);
+  
+  int pass = n && sacz < WC_QUALITY_ZMAX && keyz < WC_QUALITY_ZMAX && bicz < WC_QUALITY_ZMAX &&
+             weightz < WC_QUALITY_ZMAX && onesz < WC_QUALITY_ZMAX && bytesz < WC_QUALITY_ZMAX;
+  
+  fprintf(f, "{\"samples\":%llu,\"flips\":%llu,"
+             "\"sac\":{\"max_dev\":%.6f,\"max_z\":%.3f,\"worst\":[%d,%d]},"
+             "\"key_sac\":{\"max_dev\":%.6f,\"max_z\":%.3f,\"worst\":[%d,%d]},"
+             "\"bic\":{\"max_corr\":%.6f,\"max_z\":%.3f,\"worst\":[%d,%d]},"
+             "\"weight\":{\"mean\":%.4f,\"z\":%.3f},"
+             "\"balance\":{\"max_z\":%.3f,\"byte_chi2\":%.2f,\"byte_z\":%.3f},"
+             "\"z_limit\":%.1f,\"pass\":%s}\n",
+          (unsigned long long)n, (unsigned long long)flips,
+          n ? fabs((double)q->sac[si][sj] / n - 0.5) : 0.0, sacz, si, sj,
+          n ? fabs((double)q->keysac[ki][kj] / n - 0.5) : 0.0, keyz, ki, kj,
+          bicr, bicz, bj, bk,
+          wmean, weightz,
+          onesz, chi2, bytesz,
+          WC_QUALITY_ZMAX, pass ? "true" : "false");
+  
+  return pass;
+}
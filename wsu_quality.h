@@ -0,0 +1,56 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_quality.h:
+//  statistical quality harness interface. avalanche (SAC)
+//  for plaintext and key bits, bit independence, and output
+//  balance, run over the block engine
+
+
+// header guard
+#ifndef _WC_QUALITY_H_
+#define _WC_QUALITY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// plaintexts sharing one key (each gets 64 plaintext and 64 key flips)
+#define WC_QUALITY_BATCH 32
+
+// largest |z| score any test may show and still pass
+#define WC_QUALITY_ZMAX  5.5
+
+// summed counts from a run. bit numbers are bits of the block as a big
+// endian 64bit word, so bit 63 is the top bit of the first byte
+typedef struct WC_QUALITY {
+  uint64_t samples;         // plaintexts tried
+  uint64_t sac[64][64];     // sac[i][j]: flipping plaintext bit i flipped ciphertext bit j
+  uint64_t keysac[64][64];  // keysac[i][j]: flipping key bit i flipped ciphertext bit j
+  uint64_t bic[64][64];     // bic[j][k]: plaintext flips that flipped both j and k
+  uint64_t weight[65];      // how many ciphertext bits each plaintext flip changed
+  uint64_t ones[64];        // ciphertexts with bit j set
+  uint64_t bytes[256];      // ciphertext byte values
+} WC_QUALITY;
+
+// run the harness over samples plaintexts with kernel kern on the block engine
+// plaintexts and keys are a function of seed and sample number only, so the
+// counts dont depend on the thread count or chunk size
+WC_ERR wcQualityRun(WC_KERNEL kern, uint64_t samples, uint64_t seed, unsigned int threads, uint64_t chunk, WC_QUALITY* q);
+
+// one line JSON report of a finished run, returns nonzero if every test passed
+int wcQualityReport(FILE* f, WC_QUALITY* q);
+
+#endif //_WC_QUALITY_H_
@@ -0,0 +1,215 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_sector.c:
+//  implementation of the sector mode declared in
+//  wsu_sector.h
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_sector.h"
+
+
+// block encrypted under the data key to get the tweak key
+#define WC_SECTOR_TWEAK_CONST 0x5753552D58545321ULL   // "WSU-XTS!"
+
+
+// set up ctx for key and sectorsize byte sectors
+WC_ERR wcSectorInit(WC_SECTOR* ctx, unsigned char* key, unsigned int sectorsize) {
+  
+  if (ctx == NULL) {
+    return WC_UNKNOWN;
+  }
+  if (sectorsize < BLOCK_SIZE || sectorsize % BLOCK_SIZE != 0) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  
+  WC_ERR e;
+  if ((e = wcSchedule(key, &ctx->data)) != WC_OK) {
+    return e;
+  }
+  
+  // derive the tweak key from the data key
+  unsigned char k2[KEY_SIZE];
+  u64_bytes(WC_SECTOR_TWEAK_CONST, k2);
+  wcCipherSched(&ctx->data, k2, k2, 'e');
+  if ((e = wcSchedule(k2, &ctx->tweak)) != WC_OK) {
+    return e;
+  }
+  
+  ctx->kernel = WC_KERN_SCHED;
+  ctx->sectorsize = sectorsize;
+  ctx->pool = NULL;
+  for (int n = 0; n < WC_MAX_NODES; n++) {
+    ctx->nodes[n] = NULL;
+  }
+  
+  // about WC_DEFAULT_CHUNK blocks per chunk, rounded to whole sectors
+  ctx->chunksectors = WC_DEFAULT_CHUNK / (sectorsize / BLOCK_SIZE);
+  if (ctx->chunksectors < 1) {
+    ctx->chunksectors = 1;
+  }
+  
+  return WC_OK;
+}
+
+// release anything the context allocated (keyed tables)
+void wcSectorFree(WC_SECTOR* ctx) {
+  wcScheduleFree(&ctx->data);
+  wcScheduleFree(&ctx->tweak);
+  return;
+}
+
+// encrypt ('e') or decrypt ('d') nsectors consecutive sectors in place
+WC_ERR wcSectorCrypt(WC_SECTOR* ctx, unsigned char* buff, uint64_t first, uint64_t nsectors, char mode) {
+  
+  if (buff == NULL) {
+    return WC_BAD_SRC_BLOCK;
+  }
+  
+  WC_ERR e;
+  uint64_t bps = ctx->sectorsize / BLOCK_SIZE;
+  
+  for (uint64_t s = 0; s < nsectors; s++) {
+    unsigned char* sector = buff + s * ctx->sectorsize;
+    
+    // tweak for this sector
+    unsigned char t[BLOCK_SIZE];
+    u64_bytes(first + s, t);
+    wcCipherSched(&ctx->tweak, t, t, 'e');
+    uint64_t x = bytes_u64(t);
+    
+    // whiten on the way in, remembering each block's mask for the way out
+    // (the masks are recomputed rather than stored, doubling is cheap)
+    uint64_t mask = x;
+    for (uint64_t j = 0; j < bps; j++) {
+      unsigned char* b = sector + j * BLOCK_SIZE;
+      u64_bytes(bytes_u64(b) ^ mask, b);
+      mask = gf64_dbl(mask);
+    }
+    
+    // the whole sector goes through the kernel in one call
+    if ((e = wcCipherBlocks(ctx->kernel, &ctx->data, sector, sector, bps, mode)) != WC_OK) {
+      return e;
+    }
+    
+    mask = x;
+    for (uint64_t j = 0; j < bps; j++) {
+      unsigned char* b = sector + j * BLOCK_SIZE;
+      u64_bytes(bytes_u64(b) ^ mask, b);
+      mask = gf64_dbl(mask);
+    }
+  }
+  
+  return WC_OK;
+}
+
+// arguments for sectorChunk(), shared by every engine worker
+typedef struct WC_SECTOR_JOB {
+  WC_SECTOR* ctx;
+  int fd;
+  uint64_t first;                         // first sector of the whole range
+  char mode;
+  unsigned char* buffs[WC_MAX_THREADS];   // each worker's scratch sectors, if not pooled
+} WC_SECTOR_JOB;
+
+// engine work function. the engine counts in blocks, and chunks are a
+// whole number of sectors, so each chunk maps onto complete sectors
+static WC_ERR sectorChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_SECTOR_JOB* job = arg;
+  WC_SECTOR* ctx = job->ctx;
+  uint64_t bps = ctx->sectorsize / BLOCK_SIZE;
+  uint64_t sector = job->first + first / bps;
+  uint64_t nsectors = count / bps;
+  size_t len = nsectors * ctx->sectorsize;
+  off_t off = (off_t)sector * ctx->sectorsize;
+  unsigned char* buff = ctx->pool ? wcPoolGet(ctx->pool) : job->buffs[thread];
+  WC_SECTOR* keys = ctx->nodes[wcEngineNode(thread)];
+  WC_ERR e = WC_OK;
+  
+  // read, crypt, write back to the same place
+  if (pread_full(job->fd, buff, len, off) != U_OK) {
+    e = WC_BAD_FILE;
+  }
+  
+  if (e == WC_OK) {
+    e = wcSectorCrypt(keys ? keys : ctx, buff, sector, nsectors, job->mode);
+  }
+  
+  if (e == WC_OK && pwrite_full(job->fd, buff, len, off) != U_OK) {
+    e = WC_BAD_FILE;
+  }
+  
+  if (ctx->pool) {
+    wcPoolPut(ctx->pool, buff);
+  }
+  
+  return e;
+}
+
+// encrypt or decrypt sectors [first, first+nsectors) of an open file or
+// block device in place, split across up to threads engine workers
+WC_ERR wcSectorFile(WC_SECTOR* ctx, int fd, uint64_t first, uint64_t nsectors, char mode, unsigned int threads) {
+  
+  if (ctx == NULL || fd < 0) {
+    return WC_BAD_FILE;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  if (threads > WC_MAX_THREADS) {
+    threads = WC_MAX_THREADS;
+  }
+  
+  uint64_t bps = ctx->sectorsize / BLOCK_SIZE;
+  uint64_t spc = ctx->chunksectors;
+  if (ctx->pool != NULL && ctx->pool->size < spc * ctx->sectorsize) {
+    return WC_BAD_ALLOC;
+  }
+  
+  WC_SECTOR_JOB job;
+  memset(&job, 0, sizeof(job));
+  job.ctx = ctx;
+  job.fd = fd;
+  job.first = first;
+  job.mode = mode;
+  
+  // without a pool every worker gets its own scratch
+  WC_ERR e = WC_OK;
+  for (unsigned int t = 0; t < threads && e == WC_OK && ctx->pool == NULL; t++) {
+    if ((job.buffs[t] = malloc(spc * ctx->sectorsize)) == NULL) {
+      e = WC_BAD_ALLOC;
+    }
+  }
+  
+  if (e == WC_OK) {
+    e = wcEngineRun(threads, spc * bps, nsectors * bps, sectorChunk, &job);
+  }
+  
+  for (unsigned int t = 0; t < threads; t++) {
+    free(job.buffs[t]);
+  }
+  
+  return e;
+}
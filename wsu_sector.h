@@ -0,0 +1,74 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_sector.h:
+//  sector mode interface. XTS style tweakable encryption for
+//  disk images, where every sector can be encrypted or
+//  rewritten on its own
+
+
+// header guard
+#ifndef _WC_SECTOR_H_
+#define _WC_SECTOR_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+#include "wsu_numa.h"
+#include "wsu_pool.h"
+
+// common sector sizes in bytes. any multiple of BLOCK_SIZE works
+#define WC_SECTOR_512   512
+#define WC_SECTOR_4K    4096
+
+// block j of sector s is encrypted as
+//  C = E1(P ^ X) ^ X,  X = E2(s) * x^j  in GF(2^64)
+// so a sector only depends on its own number, and the same plaintext in two
+// sectors (or two blocks of one sector) never gives the same ciphertext
+//
+// E1 uses the key as given. E2 uses a second key derived from it as
+// E1(WC_SECTOR_TWEAK_CONST), since keys here are a single 64 bits
+//
+// NOTE: like XTS this gives no integrity, and rewriting a sector with new
+//       data leaks which blocks of it changed
+
+typedef struct WC_SECTOR {
+  WC_SCHED data;            // E1, encrypts the sector contents
+  WC_SCHED tweak;           // E2, encrypts the sector number
+  WC_KERNEL kernel;         // bulk kernel, WC_KERN_SCHED unless the caller changes it
+  unsigned int sectorsize;  // bytes per sector
+  uint64_t chunksectors;    // sectors wcSectorFile() hands a worker at a time
+  WC_POOL* pool;            // scratch buffers for wcSectorFile(), NULL to malloc them.
+                            // buffers must hold chunksectors sectors
+  struct WC_SECTOR* nodes[WC_MAX_NODES];  // copy of this context on each node for the
+                                          // wcSectorFile() workers there, NULL to share this one
+} WC_SECTOR;
+
+// set up ctx for key and sectorsize byte sectors
+WC_ERR wcSectorInit(WC_SECTOR* ctx, unsigned char* key, unsigned int sectorsize);
+
+// release anything the context allocated (keyed tables)
+void wcSectorFree(WC_SECTOR* ctx);
+
+// encrypt ('e') or decrypt ('d') nsectors consecutive sectors in place
+// buff holds the sectors, the first of which is sector number first
+WC_ERR wcSectorCrypt(WC_SECTOR* ctx, unsigned char* buff, uint64_t first, uint64_t nsectors, char mode);
+
+// encrypt or decrypt sectors [first, first+nsectors) of an open file or
+// block device in place, split across up to threads engine workers.
+// meant to be called straight from a loopback style device, in which case
+// give it a pool so repeated calls dont allocate anything
+WC_ERR wcSectorFile(WC_SECTOR* ctx, int fd, uint64_t first, uint64_t nsectors, char mode, unsigned int threads);
+
+#endif //_WC_SECTOR_H_
@@ -0,0 +1,491 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_shard.c:
+//  implementation of the sharding declared in wsu_shard.h.
+//  a shard file is its ciphertext as hex followed by one
+//  trailer line with its MAC share and a checksum, written
+//  under a temporary name and renamed once complete
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_auth.h"
+#include "wsu_engine.h"
+#include "wsu_shard.h"
+
+
+// longest trailer line
+#define WC_SHARD_TRAILER 256
+
+
+// split nblocks blocks into nshards contiguous shards
+WC_ERR wcManifestPlan(WC_MANIFEST* m, uint64_t nblocks, unsigned int nshards) {
+  
+  if (m == NULL || nshards < 1 || nshards > WC_MAX_SHARDS) {
+    return WC_UNKNOWN;
+  }
+  
+  // the first nblocks % nshards shards get one extra block
+  m->nblocks = nblocks;
+  m->nshards = nshards;
+  uint64_t first = 0;
+  for (unsigned int i = 0; i < nshards; i++) {
+    m->shards[i].first = first;
+    m->shards[i].count = nblocks / nshards + (i < nblocks % nshards);
+    first += m->shards[i].count;
+  }
+  
+  return WC_OK;
+}
+
+// running checksum over hex text, len a multiple of 8
+static uint64_t wcShardFold(uint64_t h, unsigned char* hex, size_t len) {
+  for (size_t i = 0; i < len; i += 8) {
+    h = mix64(h ^ bytes_u64(hex + i));
+  }
+  return h;
+}
+
+// checksum of shard s's range of the hex input
+static WC_ERR wcShardInputSum(int fd, WC_SHARD* s, uint64_t* sum) {
+  unsigned char buff[64 * 1024];
+  off_t off = (off_t)s->first * 2*BLOCK_SIZE;
+  off_t end = off + (off_t)s->count * 2*BLOCK_SIZE;
+  uint64_t h = mix64(s->count);
+  while (off < end) {
+    size_t n = (end - off < (off_t)sizeof(buff)) ? end - off : sizeof(buff);
+    if (pread_full(fd, buff, n, off) != U_OK) {
+      return WC_BAD_FILE;
+    }
+    h = wcShardFold(h, buff, n);
+    off += n;
+  }
+  *sum = h;
+  return WC_OK;
+}
+
+// checksum every shard's range of the input
+WC_ERR wcManifestSums(WC_MANIFEST* m) {
+  
+  int fd = open(m->input, O_RDONLY);
+  if (fd < 0) {
+    return WC_BAD_FILE;
+  }
+  
+  WC_ERR e = WC_OK;
+  for (unsigned int i = 0; i < m->nshards && e == WC_OK; i++) {
+    e = wcShardInputSum(fd, &m->shards[i], &m->shards[i].inputsum);
+  }
+  close(fd);
+  
+  return e;
+}
+
+// write a manifest
+WC_ERR wcManifestSave(char* path, WC_MANIFEST* m) {
+  
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  fprintf(f, "%s\n", WC_MANIFEST_MAGIC);
+  fprintf(f, "input=%s\n", m->input);
+  fprintf(f, "output=%s\n", m->output);
+  fprintf(f, "size=%llu\n", (unsigned long long)m->inputsize);
+  fprintf(f, "blocks=%llu\n", (unsigned long long)m->nblocks);
+  fprintf(f, "nonce=%016llX\n", (unsigned long long)m->nonce);
+  fprintf(f, "keycheck=%016llX\n", (unsigned long long)m->keycheck);
+  fprintf(f, "shards=%u\n", m->nshards);
+  
+  // byte range of the hex input, the first CTR counter and the range's
+  // checksum, one line each
+  for (unsigned int i = 0; i < m->nshards; i++) {
+    WC_SHARD* s = &m->shards[i];
+    fprintf(f, "shard=%u bytes=%llu+%llu counter=%016llX input=%016llX\n", i,
+            (unsigned long long)(s->first * 2*BLOCK_SIZE), (unsigned long long)(s->count * 2*BLOCK_SIZE),
+            (unsigned long long)(m->nonce + s->first), (unsigned long long)s->inputsum);
+  }
+  
+  if (fclose(f) != 0) {
+    return WC_BAD_FILE;
+  }
+  
+  return WC_OK;
+}
+
+// read a manifest
+WC_ERR wcManifestLoad(char* path, WC_MANIFEST* m) {
+  
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  memset(m, 0, sizeof(WC_MANIFEST));
+  
+  char line[2 * MAX_BUFF];
+  if (fgets(line, sizeof(line), f) == NULL || strncmp(line, WC_MANIFEST_MAGIC, strlen(WC_MANIFEST_MAGIC)) != 0) {
+    fclose(f);
+    return WC_BAD_FILE;
+  }
+  
+  unsigned int seen = 0;
+  int ok = 1;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    char* eq = strchr(line, '=');
+    if (line[0] == '#' || eq == NULL) {
+      continue;
+    }
+    *eq = '\0';
+    char* val = eq + 1;
+    val[strcspn(val, "\r\n")] = '\0';
+    
+    unsigned long long a;
+    unsigned long long b;
+    unsigned long long c;
+    unsigned long long d;
+    unsigned int i;
+    
+    if (strcmp(line, "input") == 0) {
+      snprintf(m->input, MAX_BUFF, "%s", val);
+    }
+    else if (strcmp(line, "output") == 0) {
+      snprintf(m->output, MAX_BUFF, "%s", val);
+    }
+    else if (strcmp(line, "size") == 0) {
+      m->inputsize = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(line, "blocks") == 0) {
+      m->nblocks = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(line, "nonce") == 0) {
+      m->nonce = strtoull(val, NULL, 16);
+    }
+    else if (strcmp(line, "keycheck") == 0) {
+      m->keycheck = strtoull(val, NULL, 16);
+    }
+    else if (strcmp(line, "shards") == 0) {
+      m->nshards = atoi(val);
+      ok = (m->nshards >= 1 && m->nshards <= WC_MAX_SHARDS);
+    }
+    else if (strcmp(line, "shard") == 0) {
+      // shards come in order, each a whole number of blocks, with the
+      // counter the nonce says it should have
+      ok = sscanf(val, "%u bytes=%llu+%llu counter=%llx input=%llx", &i, &a, &b, &c, &d) == 5 && i == seen &&
+           i < WC_MAX_SHARDS && a % (2*BLOCK_SIZE) == 0 && b % (2*BLOCK_SIZE) == 0 && c == m->nonce + a / (2*BLOCK_SIZE);
+      if (ok) {
+        m->shards[i].first = a / (2*BLOCK_SIZE);
+        m->shards[i].count = b / (2*BLOCK_SIZE);
+        m->shards[i].inputsum = d;
+        seen++;
+      }
+    }
+  }
+  fclose(f);
+  
+  // every block in exactly one shard
+  ok = ok && seen == m->nshards && m->input[0] != '\0' && m->output[0] != '\0';
+  uint64_t next = 0;
+  for (unsigned int i = 0; ok && i < m->nshards; i++) {
+    ok = (m->shards[i].first == next);
+    next += m->shards[i].count;
+  }
+  if (!ok || next != m->nblocks) {
+    return WC_BAD_FILE;
+  }
+  
+  return WC_OK;
+}
+
+// path of shard i's file
+void wcShardPath(WC_MANIFEST* m, unsigned int i, char* path, size_t len) {
+  snprintf(path, len, "%s.shard%u", m->output, i);
+  return;
+}
+
+// arguments for shardChunk(), shared by every engine worker
+typedef struct WC_SHARD_JOB {
+  WC_AUTH* ctx;
+  unsigned char* buff;              // the batch, ciphered in place
+  uint64_t first;                   // message block the batch starts at
+  uint64_t sigma[WC_MAX_THREADS];   // each worker's share of the MAC
+} WC_SHARD_JOB;
+
+// engine work function, blocks are relative to the batch
+static WC_ERR shardChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  WC_SHARD_JOB* job = arg;
+  unsigned char* blocks = job->buff + first*BLOCK_SIZE;
+  return wcAuthChunk(job->ctx, blocks, blocks, job->first + first, count, 'e', &job->sigma[thread]);
+}
+
+// worker: encrypt shard i of the input into its shard file
+WC_ERR wcShardRun(WC_MANIFEST* m, unsigned int i, WC_AUTH* ctx, unsigned int threads, uint64_t chunk, uint64_t batch) {
+  
+  struct stat st;
+  WC_ERR e = WC_OK;
+  
+  if (m == NULL || ctx == NULL || i >= m->nshards) {
+    return WC_UNKNOWN;
+  }
+  if (batch < 1) {
+    batch = WC_DEFAULT_CHUNK;
+  }
+  
+  WC_SHARD* s = &m->shards[i];
+  
+  // a different copy of the input would give a valid looking but wrong
+  // shard, so check the size and then this shard's range before any work
+  int fd = open(m->input, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return WC_BAD_FILE;
+  }
+  uint64_t sum;
+  if ((uint64_t)st.st_size != m->inputsize || (e = wcShardInputSum(fd, s, &sum)) != WC_OK || sum != s->inputsum) {
+    close(fd);
+    return (e == WC_OK) ? WC_BAD_SRC_BLOCK : e;
+  }
+  
+  char path[MAX_BUFF + 16];
+  char tmp[MAX_BUFF + 32];
+  wcShardPath(m, i, path, sizeof(path));
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE* out = fopen(tmp, "wb");
+  unsigned char* buff = malloc(batch * 2*BLOCK_SIZE);
+  if (out == NULL || buff == NULL) {
+    e = (out == NULL) ? WC_BAD_FILE : WC_BAD_ALLOC;
+  }
+  
+  WC_SHARD_JOB job;
+  memset(&job, 0, sizeof(job));
+  job.ctx = ctx;
+  job.buff = buff;
+  
+  uint64_t check = mix64(s->count);
+  for (uint64_t done = 0; done < s->count && e == WC_OK;) {
+    uint64_t n = (s->count - done < batch) ? s->count - done : batch;
+    job.first = s->first + done;
+    
+    if (pread_full(fd, buff, n * 2*BLOCK_SIZE, (off_t)job.first * 2*BLOCK_SIZE) != U_OK) {
+      e = WC_BAD_FILE;
+      break;
+    }
+    
+    // decode in place, cipher, encode back, same as the ECB path
+    if (hexblocks_decode(buff, n) != U_OK) {
+      e = WC_BAD_SRC_BLOCK;
+    }
+    if (e == WC_OK) {
+      e = wcEngineRun(threads, chunk, n, shardChunk, &job);
+    }
+    if (e == WC_OK) {
+      hexblocks_encode(buff, n);
+    }
+    
+    if (e == WC_OK && fwrite(buff, 1, n * 2*BLOCK_SIZE, out) != n * 2*BLOCK_SIZE) {
+      e = WC_BAD_FILE;
+    }
+    check = wcShardFold(check, buff, n * 2*BLOCK_SIZE);
+    done += n;
+  }
+  
+  uint64_t sigma = 0;
+  for (int t = 0; t < WC_MAX_THREADS; t++) {
+    sigma ^= job.sigma[t];
+  }
+  
+  // the trailer says which shard this is so a stray file cant be merged in
+  if (e == WC_OK) {
+    fprintf(out, "\n%s index=%u first=%llu count=%llu nonce=%016llX sigma=%016llX check=%016llX\n",
+            WC_SHARD_MAGIC, i, (unsigned long long)s->first, (unsigned long long)s->count,
+            (unsigned long long)m->nonce, (unsigned long long)sigma, (unsigned long long)check);
+    if (fflush(out) != 0 || fsync(fileno(out)) != 0) {
+      e = WC_BAD_FILE;
+    }
+  }
+  if (out != NULL && fclose(out) != 0) {
+    e = WC_BAD_FILE;
+  }
+  
+  // only a finished shard gets its real name
+  if (e == WC_OK && rename(tmp, path) != 0) {
+    e = WC_BAD_FILE;
+  }
+  if (e != WC_OK && out != NULL) {
+    remove(tmp);
+  }
+  
+  free(buff);
+  close(fd);
+  
+  return e;
+}
+
+// check shard i against the manifest and return its MAC share
+static WC_ERR wcShardCheck(WC_MANIFEST* m, unsigned int i, uint64_t* sigma) {
+  
+  WC_SHARD* s = &m->shards[i];
+  char path[MAX_BUFF + 16];
+  struct stat st;
+  wcShardPath(m, i, path, sizeof(path));
+  
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return WC_BAD_FILE;
+  }
+  
+  // the trailer starts right after the ciphertext
+  off_t len = s->count * 2*BLOCK_SIZE;
+  char trailer[WC_SHARD_TRAILER];
+  memset(trailer, 0, sizeof(trailer));
+  if (fstat(fd, &st) != 0 || st.st_size <= len || st.st_size - len >= WC_SHARD_TRAILER ||
+      pread_full(fd, (unsigned char*)trailer, st.st_size - len, len) != U_OK) {
+    close(fd);
+    return WC_BAD_FILE;
+  }
+  
+  unsigned int index;
+  unsigned long long first;
+  unsigned long long count;
+  unsigned long long nonce;
+  unsigned long long sig;
+  unsigned long long check;
+  if (sscanf(trailer, "\n" WC_SHARD_MAGIC " index=%u first=%llu count=%llu nonce=%llx sigma=%llx check=%llx",
+             &index, &first, &count, &nonce, &sig, &check) != 6 ||
+      index != i || first != s->first || count != s->count || nonce != m->nonce) {
+    close(fd);
+    return WC_BAD_FILE;
+  }
+  
+  // and the ciphertext is what the worker wrote
+  unsigned char buff[64 * 1024];
+  uint64_t h = mix64(s->count);
+  for (off_t off = 0; off < len;) {
+    size_t n = (len - off < (off_t)sizeof(buff)) ? len - off : sizeof(buff);
+    if (pread_full(fd, buff, n, off) != U_OK) {
+      close(fd);
+      return WC_BAD_FILE;
+    }
+    h = wcShardFold(h, buff, n);
+    off += n;
+  }
+  close(fd);
+  
+  if (h != check) {
+    return WC_BAD_FILE;
+  }
+  
+  *sigma = sig;
+  
+  return WC_OK;
+}
+
+// append shard i's ciphertext to out
+static WC_ERR wcShardCopy(WC_MANIFEST* m, unsigned int i, FILE* out) {
+  
+  char path[MAX_BUFF + 16];
+  wcShardPath(m, i, path, sizeof(path));
+  
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  unsigned char buff[64 * 1024];
+  uint64_t left = m->shards[i].count * 2*BLOCK_SIZE;
+  while (left > 0) {
+    size_t n = (left < sizeof(buff)) ? left : sizeof(buff);
+    if (fread(buff, 1, n, f) != n || fwrite(buff, 1, n, out) != n) {
+      fclose(f);
+      return WC_BAD_FILE;
+    }
+    left -= n;
+  }
+  fclose(f);
+  
+  return WC_OK;
+}
+
+// check every shard and write the container
+WC_ERR wcShardMerge(WC_MANIFEST* m, WC_AUTH* ctx, unsigned int* missing) {
+  
+  WC_ERR e;
+  uint64_t sigma = 0;
+  
+  if (missing != NULL) {
+    *missing = m->nshards;
+  }
+  
+  // everything has to be there before anything is written
+  for (unsigned int i = 0; i < m->nshards; i++) {
+    uint64_t part;
+    if ((e = wcShardCheck(m, i, &part)) != WC_OK) {
+      if (missing != NULL) {
+        *missing = i;
+      }
+      return e;
+    }
+    sigma ^= part;
+  }
+  
+  char tmp[MAX_BUFF + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", m->output);
+  FILE* out = fopen(tmp, "wb");
+  if (out == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  // nonce | ciphertext | tag, all hex
+  unsigned char block[BLOCK_SIZE];
+  unsigned char hex[2*BLOCK_SIZE];
+  u64_bytes(m->nonce, block);
+  bytes_hexstr(block, hex, BLOCK_SIZE);
+  e = (fwrite(hex, 1, sizeof(hex), out) == sizeof(hex)) ? WC_OK : WC_BAD_FILE;
+  
+  for (unsigned int i = 0; i < m->nshards && e == WC_OK; i++) {
+    e = wcShardCopy(m, i, out);
+  }
+  
+  if (e == WC_OK) {
+    wcAuthFinal(ctx, sigma, block);
+    bytes_hexstr(block, hex, BLOCK_SIZE);
+    e = (fwrite(hex, 1, sizeof(hex), out) == sizeof(hex)) ? WC_OK : WC_BAD_FILE;
+  }
+  
+  if (fclose(out) != 0) {
+    e = WC_BAD_FILE;
+  }
+  if (e == WC_OK && rename(tmp, m->output) != 0) {
+    e = WC_BAD_FILE;
+  }
+  if (e != WC_OK) {
+    remove(tmp);
+  }
+  
+  return e;
+}
@@ -0,0 +1,87 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_shard.h:
+//  sharding interface. splits one authenticated encryption
+//  into independent block ranges that separate processes (or
+//  machines) can do on their own, then stitches the pieces
+//  into the usual nonce | ciphertext | tag container
+
+
+// header guard
+#ifndef _WC_SHARD_H_
+#define _WC_SHARD_H_
+
+#include <stdint.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_auth.h"
+
+// first line of a manifest, and of a shard's trailer
+#define WC_MANIFEST_MAGIC "wsucrypt-manifest 2"
+#define WC_SHARD_MAGIC    "wsucrypt-shard 1"
+
+// most shards one manifest can hold
+#define WC_MAX_SHARDS 4096
+
+// one worker's share. bytes of the hex input are [first*16, (first+count)*16)
+// and its CTR counters start at nonce + first
+typedef struct WC_SHARD {
+  uint64_t first;     // first message block
+  uint64_t count;     // blocks
+  uint64_t inputsum;  // checksum of the shard's hex input, see wcManifestSums()
+} WC_SHARD;
+
+// everything the workers and the merge need to agree on. the key isnt in
+// here, only a check value so a worker with the wrong key stops early
+typedef struct WC_MANIFEST {
+  char input[MAX_BUFF];     // hex plaintext, as every worker should open it
+  char output[MAX_BUFF];    // final container, shards are OUTPUT.shardN
+  uint64_t inputsize;       // bytes, so a worker can tell its copy matches
+  uint64_t nblocks;         // plaintext blocks in the whole message
+  uint64_t nonce;
+  uint64_t keycheck;        // wcKeyCheck() of the key
+  unsigned int nshards;
+  WC_SHARD shards[WC_MAX_SHARDS];
+} WC_MANIFEST;
+
+// split nblocks blocks into nshards contiguous shards as even as possible
+WC_ERR wcManifestPlan(WC_MANIFEST* m, uint64_t nblocks, unsigned int nshards);
+
+// checksum every shard's range of the input, so a worker can tell its copy
+// of the input is the one that was planned from
+WC_ERR wcManifestSums(WC_MANIFEST* m);
+
+// write or read a manifest (key=value text). loading checks the shards
+// cover every block exactly once
+WC_ERR wcManifestSave(char* path, WC_MANIFEST* m);
+WC_ERR wcManifestLoad(char* path, WC_MANIFEST* m);
+
+// path of shard i's file
+void wcShardPath(WC_MANIFEST* m, unsigned int i, char* path, size_t len);
+
+// worker: encrypt shard i of the input into its shard file. ctx must be set
+// up for the manifest's key, nonce and nblocks. batch blocks are read at a
+// time and spread over threads engine workers chunk blocks at a time
+// WC_BAD_SRC_BLOCK, before anything is ciphered, if the input's size or the
+// shard's range of it dont match the manifest
+WC_ERR wcShardRun(WC_MANIFEST* m, unsigned int i, WC_AUTH* ctx, unsigned int threads, uint64_t chunk, uint64_t batch);
+
+// check every shard is there, complete and from this manifest, then write
+// the container. nothing is written unless every shard checks out; missing
+// (if not NULL) gets the first shard that didnt, or m->nshards if none
+WC_ERR wcShardMerge(WC_MANIFEST* m, WC_AUTH* ctx, unsigned int* missing);
+
+#endif //_WC_SHARD_H_
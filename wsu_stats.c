@@ -0,0 +1,226 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_stats.c:
+//  implementation of the throughput statistics declared in
+//  wsu_stats.h
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "util.h"
+#include "wsu_stats.h"
+#include "wsu_pipe.h"
+
+
+// per-thread counters
+WC_COUNTERS G_WC_STATS[WC_MAX_THREADS];
+
+// when the counters were last reset
+static uint64_t startns;
+
+// pool to report on, if any
+static WC_POOL* watchpool = NULL;
+
+// pipeline to report on, if any
+static WC_PIPE* watchpipe = NULL;
+
+// background reporter state
+static pthread_t timertid;
+static pthread_mutex_t timerlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timercond = PTHREAD_COND_INITIALIZER;
+static int timerrunning = 0;
+static unsigned int timersecs;
+static FILE* timerfile;
+
+// stage names in the order of WC_STAGE
+static char* stagenames[WC_NUM_STAGES] = {
+  "read", "decode", "cipher", "encode", "write"
+};
+
+
+// read a counter from any thread
+#define WC_STAT_GET(thread, field) \
+  __atomic_load_n(&G_WC_STATS[(thread)].field, __ATOMIC_RELAXED)
+
+// monotonic clock in nanoseconds
+uint64_t wcNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// reset every counter and start the clock
+void wcStatsInit(void) {
+  memset(G_WC_STATS, 0, sizeof(G_WC_STATS));
+  startns = wcNow();
+  return;
+}
+
+// include a buffer pool's pressure in the reports (NULL to stop)
+void wcStatsWatchPool(WC_POOL* pool) {
+  watchpool = pool;
+  return;
+}
+
+// include a pipeline's counters in the reports (NULL to stop)
+void wcStatsWatchPipe(WC_PIPE* pipe) {
+  watchpipe = pipe;
+  return;
+}
+
+// returns the name of a driver stage
+char* wcStageName(WC_STAGE stage) {
+  return (stage < WC_NUM_STAGES) ? stagenames[stage] : "unknown";
+}
+
+// print a JSON snapshot of the summed counters on a single line
+void wcStatsReport(FILE* f, int final) {
+  
+  double elapsed = (wcNow() - startns) / 1e9;
+  uint64_t blocks = 0;
+  uint64_t keysetups = 0;
+  uint64_t stagens[WC_NUM_STAGES] = {0};
+  uint64_t memolookups = 0;
+  uint64_t memohits = 0;
+  uint64_t memozeros = 0;
+  uint64_t memobypassed = 0;
+  
+  // sum everything up
+  for (int t = 0; t < WC_MAX_THREADS; t++) {
+    blocks += WC_STAT_GET(t, blocks);
+    keysetups += WC_STAT_GET(t, keysetups);
+    memolookups += WC_STAT_GET(t, memolookups);
+    memohits += WC_STAT_GET(t, memohits);
+    memozeros += WC_STAT_GET(t, memozeros);
+    memobypassed += WC_STAT_GET(t, memobypassed);
+    for (int s = 0; s < WC_NUM_STAGES; s++) {
+      stagens[s] += WC_STAT_GET(t, stagens[s]);
+    }
+  }
+  
+  uint64_t bytes = blocks * BLOCK_SIZE;
+  
+  fprintf(f, "{\"final\":%s,\"elapsed_s\":%.6f,\"bytes\":%llu,\"blocks\":%llu,\"mb_per_s\":%.3f,\"key_setups\":%llu,",
+          final ? "true" : "false", elapsed, (unsigned long long)bytes, (unsigned long long)blocks,
+          elapsed > 0 ? bytes / elapsed / 1e6 : 0.0, (unsigned long long)keysetups);
+  
+  fprintf(f, "\"stages_s\":{");
+  for (int s = 0; s < WC_NUM_STAGES; s++) {
+    fprintf(f, "%s\"%s\":%.6f", s ? "," : "", stagenames[s], stagens[s] / 1e9);
+  }
+  fprintf(f, "},");
+  
+  // only list threads that did something (worker 0 always shows up)
+  fprintf(f, "\"threads\":[");
+  int first = 1;
+  for (int t = 0; t < WC_MAX_THREADS; t++) {
+    uint64_t chunks = WC_STAT_GET(t, chunks);
+    if (t != 0 && chunks == 0) {
+      continue;
+    }
+    double busy = WC_STAT_GET(t, busyns) / 1e9;
+    fprintf(f, "%s{\"id\":%d,\"blocks\":%llu,\"chunks\":%llu,\"busy_s\":%.6f,\"utilization\":%.4f}",
+            first ? "" : ",", t, (unsigned long long)WC_STAT_GET(t, blocks), (unsigned long long)chunks,
+            busy, elapsed > 0 ? busy / elapsed : 0.0);
+    first = 0;
+  }
+  fprintf(f, "]");
+  
+  // hit rate counts the zero runs too, theyre what the memo saves most on
+  if (memolookups || memozeros || memobypassed) {
+    uint64_t seen = memolookups + memozeros + memobypassed;
+    fprintf(f, ",\"memo\":{\"lookups\":%llu,\"hits\":%llu,\"zero_blocks\":%llu,\"bypassed\":%llu,\"hit_rate\":%.4f}",
+            (unsigned long long)memolookups, (unsigned long long)memohits, (unsigned long long)memozeros,
+            (unsigned long long)memobypassed, (double)(memohits + memozeros) / seen);
+  }
+  
+  if (watchpool != NULL) {
+    pthread_mutex_lock(&watchpool->lock);
+    fprintf(f, ",\"pool\":{\"buffers\":%u,\"buffer_bytes\":%zu,\"pages\":\"%s\",\"in_use\":%u,\"peak_in_use\":%u,"
+               "\"gets\":%llu,\"waits\":%llu,\"wait_s\":%.6f}",
+            watchpool->count, watchpool->size, wcPoolPagesName(watchpool->pages),
+            watchpool->count - watchpool->nfree, watchpool->peak, (unsigned long long)watchpool->gets,
+            (unsigned long long)watchpool->waits, watchpool->waitns / 1e9);
+    pthread_mutex_unlock(&watchpool->lock);
+  }
+  
+  if (watchpipe != NULL) {
+    fprintf(f, ",\"pipeline\":");
+    wcPipeReport(f, watchpipe);
+  }
+  
+  fprintf(f, "}\n");
+  fflush(f);
+  
+  return;
+}
+
+// background reporter, wakes up every timersecs until told to stop
+static void* wcStatsTimer(void* arg) {
+  pthread_mutex_lock(&timerlock);
+  while (timerrunning) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += timersecs;
+    
+    // a stop request signals the cond and cuts the wait short
+    if (pthread_cond_timedwait(&timercond, &timerlock, &until) != 0 && timerrunning) {
+      wcStatsReport(timerfile, 0);
+    }
+  }
+  pthread_mutex_unlock(&timerlock);
+  
+  return NULL;
+}
+
+// print a snapshot every secs seconds from a background thread
+int wcStatsStartTimer(FILE* f, unsigned int secs) {
+  if (secs == 0 || timerrunning) {
+    return -1;
+  }
+  
+  timerfile = f;
+  timersecs = secs;
+  timerrunning = 1;
+  if (pthread_create(&timertid, NULL, wcStatsTimer, NULL) != 0) {
+    timerrunning = 0;
+    return -1;
+  }
+  
+  return 0;
+}
+
+// stop the background reporter
+void wcStatsStopTimer(void) {
+  if (!timerrunning) {
+    return;
+  }
+  
+  pthread_mutex_lock(&timerlock);
+  timerrunning = 0;
+  pthread_cond_signal(&timercond);
+  pthread_mutex_unlock(&timerlock);
+  
+  pthread_join(timertid, NULL);
+  
+  return;
+}
@@ -0,0 +1,99 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_stats.h:
+//  throughput statistics interface. per-thread counters that
+//  only their own thread writes, summed up when a report is
+//  printed as JSON
+
+
+// header guard
+#ifndef _WC_STATS_H_
+#define _WC_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "wsu_engine.h"
+#include "wsu_pool.h"
+
+// pipeline stages the driver times
+typedef enum WC_STAGE {
+  WC_STAGE_READ,
+  WC_STAGE_DECODE,
+  WC_STAGE_CIPHER,
+  WC_STAGE_ENCODE,
+  WC_STAGE_WRITE,
+  WC_NUM_STAGES
+} WC_STAGE;
+
+// one thread's counters. aligned to a cache line so two workers never
+// bounce the same line back and forth
+typedef struct WC_COUNTERS {
+  uint64_t blocks;                    // blocks through the cipher
+  uint64_t chunks;                    // engine chunks run
+  uint64_t keysetups;                 // key schedules built
+  uint64_t busyns;                    // time spent inside engine chunks
+  uint64_t stagens[WC_NUM_STAGES];    // time spent in each driver stage
+  uint64_t memolookups;               // blocks looked up in an ECB memo
+  uint64_t memohits;                  // and found there
+  uint64_t memozeros;                 // zero blocks copied from a memo without a lookup
+  uint64_t memobypassed;              // blocks ciphered after a memo gave up
+} __attribute__((aligned(64))) WC_COUNTERS;
+
+// one slot per engine worker, indexed by the engine's thread number
+// (the driver itself runs as worker 0)
+extern WC_COUNTERS G_WC_STATS[WC_MAX_THREADS];
+
+// bump a counter in a thread's own slot
+// relaxed load and store rather than an atomic add: only the owner ever
+// writes its slot, so theres nothing to lock, and the reporter just needs
+// to never see a torn value
+#define WC_STAT_ADD(thread, field, n) \
+  __atomic_store_n(&G_WC_STATS[(thread)].field, \
+                   __atomic_load_n(&G_WC_STATS[(thread)].field, __ATOMIC_RELAXED) + (n), \
+                   __ATOMIC_RELAXED)
+
+// bump a counter that more than one thread writes, a real atomic add.
+// the stage times in slot 0 are these, since every pipeline stage thread
+// adds its own time there alongside the driver
+#define WC_STAT_ADD_SHARED(thread, field, n) \
+  __atomic_fetch_add(&G_WC_STATS[(thread)].field, (n), __ATOMIC_RELAXED)
+
+// monotonic clock in nanoseconds
+uint64_t wcNow(void);
+
+// reset every counter and start the clock
+void wcStatsInit(void);
+
+// include a buffer pool's pressure in the reports (NULL to stop)
+void wcStatsWatchPool(WC_POOL* pool);
+
+// include a pipeline's stage and ring counters in the reports (NULL to stop)
+struct WC_PIPE;
+void wcStatsWatchPipe(struct WC_PIPE* pipe);
+
+// returns the name of a driver stage
+char* wcStageName(WC_STAGE stage);
+
+// print a JSON snapshot of the summed counters on a single line
+void wcStatsReport(FILE* f, int final);
+
+// print a snapshot every secs seconds from a background thread
+int wcStatsStartTimer(FILE* f, unsigned int secs);
+
+// stop the background reporter
+void wcStatsStopTimer(void);
+
+#endif //_WC_STATS_H_
@@ -0,0 +1,366 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_tune.c:
+//  implementation of the auto-tuner declared in wsu_tune.h.
+//  tunes in three steps, each building on the last winner:
+//  kernel on one thread, then threads and chunk size on the
+//  engine, then the read batch size on the whole ECB loop
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "wsu_crypt.h"
+#include "wsu_engine.h"
+#include "wsu_stats.h"
+#include "wsu_tune.h"
+
+
+// how long each measurement runs for, in nanoseconds
+#define TUNE_NS         150000000ULL
+
+// blocks in the kernel and engine test buffers
+#define TUNE_KBLOCKS    (1 << 14)
+#define TUNE_EBLOCKS    (1 << 20)
+
+// hex blocks in the scratch file for the batch test, and the biggest
+// batch tried (one batch that reads the whole file)
+#define TUNE_IOBLOCKS   (1 << 19)
+
+// candidate settings
+static uint64_t chunks[] = { 256, 1024, 4096, 16384 };
+static uint64_t batches[] = { 1, 4, 16, 64 };   // multiples of chunk * threads, up to TUNE_IOBLOCKS
+
+
+// fill prof with the settings used when theres no profile
+void wcProfileDefaults(WC_PROFILE* prof) {
+  prof->kernel = WC_KERN_SCHED;
+  prof->threads = 1;
+  prof->chunk = WC_DEFAULT_CHUNK;
+  prof->batch = WC_DEFAULT_CHUNK * 4;
+  return;
+}
+
+// put the default profile path for this host in path
+WC_ERR wcProfilePath(char* path, unsigned int size) {
+  
+  char* env = getenv(WC_PROFILE_ENV);
+  if (env != NULL && env[0] != '\0') {
+    snprintf(path, size, "%s", env);
+    return WC_OK;
+  }
+  
+  char* home = getenv("HOME");
+  char host[256];
+  if (home == NULL || gethostname(host, sizeof(host)) != 0) {
+    return WC_BAD_FILE;
+  }
+  host[sizeof(host)-1] = '\0';
+  
+  snprintf(path, size, "%s/.wsucrypt-%s", home, host);
+  
+  return WC_OK;
+}
+
+// load a profile. settings missing from the file are left alone
+// format is one key=value per line, # starts a comment
+WC_ERR wcProfileLoad(char* path, WC_PROFILE* prof) {
+  
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  char line[MAX_BUFF];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char* eq = strchr(line, '=');
+    if (line[0] == '#' || eq == NULL) {
+      continue;
+    }
+    *eq = '\0';
+    char* val = eq + 1;
+    val[strcspn(val, "\r\n")] = '\0';
+    
+    if (strcmp(line, "kernel") == 0) {
+      WC_KERNEL k = wcKernelParse(val);
+      if (k != WC_NUM_KERNELS) {
+        prof->kernel = k;
+      }
+    }
+    else if (strcmp(line, "threads") == 0 && atoi(val) > 0) {
+      prof->threads = atoi(val);
+    }
+    else if (strcmp(line, "chunk") == 0 && atoll(val) > 0) {
+      prof->chunk = atoll(val);
+    }
+    else if (strcmp(line, "batch") == 0 && atoll(val) > 0) {
+      prof->batch = atoll(val);
+    }
+  }
+  
+  fclose(f);
+  
+  return WC_OK;
+}
+
+// save a profile
+WC_ERR wcProfileSave(char* path, WC_PROFILE* prof) {
+  
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    return WC_BAD_FILE;
+  }
+  
+  fprintf(f, "# wsucrypt tuning profile, written by wsucrypt tune\n");
+  fprintf(f, "kernel=%s\n", wcKernelName(prof->kernel));
+  fprintf(f, "threads=%u\n", prof->threads);
+  fprintf(f, "chunk=%llu\n", (unsigned long long)prof->chunk);
+  fprintf(f, "batch=%llu\n", (unsigned long long)prof->batch);
+  
+  fclose(f);
+  
+  return WC_OK;
+}
+
+// arguments for tuneChunk()
+typedef struct TUNE_JOB {
+  WC_KERNEL kernel;
+  WC_SCHED* sched;
+  unsigned char* buff;
+} TUNE_JOB;
+
+// engine work function, encrypts the chunk in place
+static WC_ERR tuneChunk(void* arg, unsigned int thread, uint64_t first, uint64_t count) {
+  TUNE_JOB* job = arg;
+  unsigned char* p = job->buff + first * BLOCK_SIZE;
+  return wcCipherBlocks(job->kernel, job->sched, p, p, count, 'e');
+}
+
+// blocks per second for a kernel on one thread, in *rate
+static WC_ERR tuneKernel(WC_KERNEL kern, WC_SCHED* sched, unsigned char* buff, double* rate) {
+  WC_ERR e;
+  uint64_t done = 0;
+  uint64_t start = wcNow();
+  uint64_t elapsed;
+  
+  // the reference kernel is slow and chatty in debug builds, give it less
+  uint64_t n = (kern == WC_KERN_REF) ? 64 : TUNE_KBLOCKS;
+  
+  do {
+    if ((e = wcCipherBlocks(kern, sched, buff, buff, n, 'e')) != WC_OK) {
+      return e;
+    }
+    done += n;
+    elapsed = wcNow() - start;
+  } while (elapsed < TUNE_NS);
+  
+  *rate = done / (elapsed / 1e9);
+  return WC_OK;
+}
+
+// blocks per second through the engine with the given settings, in *rate
+static WC_ERR tuneEngine(TUNE_JOB* job, unsigned int threads, uint64_t chunk, double* rate) {
+  WC_ERR e;
+  uint64_t done = 0;
+  uint64_t start = wcNow();
+  uint64_t elapsed;
+  
+  do {
+    if ((e = wcEngineRun(threads, chunk, TUNE_EBLOCKS, tuneChunk, job)) != WC_OK) {
+      return e;
+    }
+    done += TUNE_EBLOCKS;
+    elapsed = wcNow() - start;
+  } while (elapsed < TUNE_NS);
+  
+  *rate = done / (elapsed / 1e9);
+  return WC_OK;
+}
+
+// blocks per second through the same steps as the ECB loop (read, decode,
+// cipher on the engine, encode, write) with batch blocks at a time, using
+// a scratch file of TUNE_IOBLOCKS blocks, in *rate
+static WC_ERR tuneIO(TUNE_JOB* job, WC_PROFILE* prof, FILE* scratch, FILE* sink, uint64_t batch, double* rate) {
+  
+  WC_ERR e = WC_OK;
+  unsigned char* buff = malloc(batch * 2*BLOCK_SIZE);
+  if (buff == NULL) {
+    return WC_BAD_ALLOC;
+  }
+  job->buff = buff;
+  
+  uint64_t done = 0;
+  uint64_t start = wcNow();
+  uint64_t elapsed;
+  
+  do {
+    rewind(scratch);
+    rewind(sink);
+    uint64_t n;
+    while (e == WC_OK && (n = fread(buff, 1, batch * 2*BLOCK_SIZE, scratch) / (2*BLOCK_SIZE)) > 0) {
+      hexblocks_decode(buff, n);
+      e = wcEngineRun(prof->threads, prof->chunk, n, tuneChunk, job);
+      hexblocks_encode(buff, n);
+      fwrite(buff, 1, n * 2*BLOCK_SIZE, sink);
+      done += n;
+    }
+    fflush(sink);
+    elapsed = wcNow() - start;
+  } while (e == WC_OK && elapsed < TUNE_NS);
+  
+  free(buff);
+  
+  *rate = done / (elapsed / 1e9);
+  return e;
+}
+
+// run the calibration benchmarks and put the fastest settings in prof
+WC_ERR wcTune(WC_PROFILE* prof, int verbose) {
+  
+  WC_ERR e;
+  WC_SCHED sched;
+  unsigned char key[KEY_SIZE] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+  
+  if ((e = wcSchedule(key, &sched)) != WC_OK || (e = wcScheduleTables(&sched)) != WC_OK) {
+    return e;
+  }
+  
+  unsigned char* buff = malloc(TUNE_EBLOCKS * BLOCK_SIZE);
+  if (buff == NULL) {
+    wcScheduleFree(&sched);
+    return WC_BAD_ALLOC;
+  }
+  for (uint64_t i = 0; i < TUNE_EBLOCKS * BLOCK_SIZE; i++) {
+    buff[i] = (i * 131) ^ (i >> 8);
+  }
+  
+  // step 1: kernel, single threaded
+  double best = 0;
+  for (int k = 0; k < WC_NUM_KERNELS; k++) {
+    double rate;
+    if ((e = tuneKernel(k, &sched, buff, &rate)) != WC_OK) {
+      free(buff);
+      wcScheduleFree(&sched);
+      return e;
+    }
+    if (verbose) {
+      printf("kernel  %-6s            %10.2f MB/s\n", wcKernelName(k), rate * BLOCK_SIZE / 1e6);
+    }
+    // the reference kernel cant be shared between threads, never pick it
+    if (k != WC_KERN_REF && rate > best) {
+      best = rate;
+      prof->kernel = k;
+    }
+  }
+  
+  // step 2: threads and chunk size on the engine
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpu < 1) {
+    ncpu = 1;
+  }
+  if (ncpu > WC_MAX_THREADS) {
+    ncpu = WC_MAX_THREADS;
+  }
+  
+  TUNE_JOB job;
+  job.kernel = prof->kernel;
+  job.sched = &sched;
+  job.buff = buff;
+  
+  best = 0;
+  for (unsigned int t = 1; ; t = (t * 2 > ncpu && t < ncpu) ? ncpu : t * 2) {
+    for (int c = 0; c < sizeof(chunks)/sizeof(chunks[0]); c++) {
+      double rate;
+      if ((e = tuneEngine(&job, t, chunks[c], &rate)) != WC_OK) {
+        free(buff);
+        wcScheduleFree(&sched);
+        return e;
+      }
+      if (verbose) {
+        printf("engine  threads %-3u chunk %-6llu %10.2f MB/s\n", t, (unsigned long long)chunks[c], rate * BLOCK_SIZE / 1e6);
+      }
+      
+      // only move to more threads or bigger chunks if they buy at least 5%
+      if (rate > best * 1.05) {
+        best = rate;
+        prof->threads = t;
+        prof->chunk = chunks[c];
+      }
+    }
+    if (t >= ncpu) {
+      break;
+    }
+  }
+  
+  free(buff);
+  
+  // step 3: read batch size on the whole loop, with the winners so far
+  FILE* scratch = tmpfile();
+  FILE* sink = tmpfile();
+  if (scratch == NULL || sink == NULL) {
+    // either one may have been opened before the other failed
+    if (scratch != NULL) {
+      fclose(scratch);
+    }
+    if (sink != NULL) {
+      fclose(sink);
+    }
+    wcScheduleFree(&sched);
+    return WC_BAD_FILE;
+  }
+  for (uint64_t i = 0; i < TUNE_IOBLOCKS; i++) {
+    fputs("0123456789ABCDEF", scratch);
+  }
+  
+  best = 0;
+  uint64_t base = prof->chunk * prof->threads;
+  uint64_t last = 0;
+  for (int b = 0; b < sizeof(batches)/sizeof(batches[0]); b++) {
+    // past the size of the scratch file every batch does the same reads,
+    // so the file size is the biggest one worth timing
+    uint64_t batch = base * batches[b];
+    if (batch > TUNE_IOBLOCKS) {
+      batch = TUNE_IOBLOCKS;
+    }
+    if (batch == last) {
+      continue;
+    }
+    last = batch;
+    
+    double rate;
+    if ((e = tuneIO(&job, prof, scratch, sink, batch, &rate)) != WC_OK) {
+      break;
+    }
+    if (verbose) {
+      printf("io      batch %-10llu     %10.2f MB/s\n", (unsigned long long)batch, rate * BLOCK_SIZE / 1e6);
+    }
+    if (rate > best) {
+      best = rate;
+      prof->batch = batch;
+    }
+  }
+  
+  fclose(scratch);
+  fclose(sink);
+  wcScheduleFree(&sched);
+  
+  return e;
+}
@@ -0,0 +1,57 @@
+// Brandon Warner
+// @dragonflare921
+// dragonflare921@gmail.com
+//
+// WSU-Crypt
+//
+// simple implementation of WSU-Crypt encryption algorithm
+//
+// based on the Twofish block cipher by Bruce Schneier,
+// John Kelsey, Doug Witing, David Wagner, and Chris Hall
+// and the SKIPJACK block cipher by the NSA
+//
+// uses 64 bit blocks and 64 bit keys
+//
+// wsu_tune.h:
+//  auto-tuner interface. benchmarks the kernels, engine and
+//  ECB loop on this host and keeps the winners in a small
+//  per-host profile file
+
+
+// header guard
+#ifndef _WC_TUNE_H_
+#define _WC_TUNE_H_
+
+#include <stdint.h>
+
+#include "wsu_crypt.h"
+
+// environment variable that overrides the default profile location
+#define WC_PROFILE_ENV    "WSUCRYPT_PROFILE"
+
+// engine settings the tuner picks
+typedef struct WC_PROFILE {
+  WC_KERNEL kernel;       // bulk kernel
+  unsigned int threads;   // engine workers
+  uint64_t chunk;         // blocks per engine chunk
+  uint64_t batch;         // blocks read from disk at a time
+} WC_PROFILE;
+
+// fill prof with the settings used when theres no profile
+void wcProfileDefaults(WC_PROFILE* prof);
+
+// put the default profile path for this host in path
+// $WSUCRYPT_PROFILE if set, otherwise $HOME/.wsucrypt-<hostname>
+WC_ERR wcProfilePath(char* path, unsigned int size);
+
+// load a profile. settings missing from the file are left alone
+WC_ERR wcProfileLoad(char* path, WC_PROFILE* prof);
+
+// save a profile
+WC_ERR wcProfileSave(char* path, WC_PROFILE* prof);
+
+// run the calibration benchmarks and put the fastest settings in prof
+// progress goes to stdout if verbose is nonzero
+WC_ERR wcTune(WC_PROFILE* prof, int verbose);
+
+#endif //_WC_TUNE_H_